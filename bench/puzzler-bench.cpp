@@ -0,0 +1,287 @@
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../detail/option-builder.hpp"
+#include "../detail/puzzle-generator.hpp"
+#include "../detail/puzzle-reader.hpp"
+#include "../detail/puzzle-simulator.hpp"
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+/*
+ * Collects one JSON object per benchmark so runs can be compared over time.
+ */
+class Report
+{
+public:
+	using Metrics = std::vector<std::pair<std::string, double>>;
+
+	void add( const std::string& name, const Metrics& metrics)
+	{
+		std::ostringstream entry;
+		entry << "    {\"name\": \"" << name << '"';
+		for( auto& [ key, value] : metrics)
+			entry << ", \"" << key << "\": " << value;
+		entry << '}';
+		entries.push_back( entry.str());
+		fprintf( stderr, "%s\n", entry.str().c_str() + 4);
+	}
+
+	void print( FILE *out) const
+	{
+		fprintf( out, "{\n  \"benchmarks\": [\n");
+		for( size_t i = 0; i < entries.size(); ++i)
+			fprintf( out, "%s%s\n", entries[ i].c_str(), i + 1 == entries.size() ? "" : ",");
+		fprintf( out, "  ]\n}\n");
+	}
+
+private:
+	std::vector<std::string> entries;
+};
+
+template<typename Fn>
+double bestOf( size_t repeats, Fn&& fn)
+{
+	double best = 1e300;
+	for( size_t i = 0; i < repeats; ++i)
+	{
+		auto start = Clock::now();
+		fn();
+		best = std::min( best, std::chrono::duration<double>( Clock::now() - start).count());
+	}
+	return best;
+}
+
+/*
+ * A square grid with keys written into it in all 8 directions, so about half
+ * of them are only found read backwards.
+ */
+detail::PuzzleGenerator::Puzzle synthesize( size_t size, size_t n_keys, uint64_t seed)
+{
+	detail::GeneratorSpec spec;
+	spec.seed       = seed;
+	spec.rows       = spec.cols = size;
+	spec.keys       = n_keys;
+	spec.min_length = 4;
+	spec.max_length = 10;
+	return detail::PuzzleGenerator( spec).next();
+}
+
+void benchParse( Report& report, size_t repeats)
+{
+	detail::GeneratorSpec spec;
+	spec.puzzles = 1000;
+	spec.rows    = spec.cols = 100;
+	spec.keys    = 50;
+	std::ostringstream strm;
+	detail::PuzzleGenerator( spec).write( strm);
+	auto text = strm.str();
+
+	char path[] = "/tmp/puzzler-bench-XXXXXX";
+	int fd = mkstemp( path);
+	if( fd < 0 || write( fd, text.data(), text.size()) != static_cast<ssize_t>( text.size()))
+	{
+		fprintf( stderr, "Unable to write %s\n", path);
+		exit( EXIT_FAILURE);
+	}
+	close( fd);
+
+	auto megabytes = static_cast<double>( text.size()) / ( 1024.0 * 1024.0);
+	size_t parsed = 0;
+	auto mapped = bestOf( repeats, [ &]
+	{
+		PuzzleFileReader reader( detail::MappedFile::open( path));
+		parsed = reader.getPuzzles().size();
+	});
+	report.add( "parse/mmap", {{ "megabytes", megabytes}, { "puzzles", static_cast<double>( parsed)},
+	                           { "seconds", mapped}, { "mb_per_s", megabytes / mapped}});
+
+	auto streamed = bestOf( repeats, [ &]
+	{
+		std::ifstream file( path);
+		PuzzleFileReader reader( file);
+		parsed = reader.getPuzzles().size();
+	});
+	report.add( "parse/istream", {{ "megabytes", megabytes}, { "puzzles", static_cast<double>( parsed)},
+	                              { "seconds", streamed}, { "mb_per_s", megabytes / streamed}});
+	unlink( path);
+}
+
+void benchSolve( Report& report, size_t repeats, bool full)
+{
+	const std::pair<const char *, PuzzleSolver::Engine> engines[] = {
+		{ "tracker",      PuzzleSolver::Engine::Tracker},
+		{ "aho-corasick", PuzzleSolver::Engine::AhoCorasick},
+		{ "scan",         PuzzleSolver::Engine::Scan},
+		{ "bitboard",     PuzzleSolver::Engine::Bitboard},
+		{ "packed",       PuzzleSolver::Engine::Packed}
+	};
+	for( size_t size : { 25, 50, 100, 200, 400})
+	{
+		for( size_t n_keys : { 10, 50, 200})
+		{
+			auto puzzle = synthesize( size, n_keys, size * 1000 + n_keys);
+			detail::PuzzleGrid grid( puzzle.rows);
+			for( auto& [ name, engine] : engines)
+			{
+				// The tracker engine grows too quickly to sweep every size by default.
+				if( engine == PuzzleSolver::Engine::Tracker && !full && ( size > 50 || n_keys > 50))
+					continue;
+
+				auto label = std::string( "solve/") + name + "/" + std::to_string( size) + "x"
+				             + std::to_string( size) + "/keys=" + std::to_string( n_keys);
+				Report::Metrics metrics = {{ "cells", static_cast<double>( size * size)},
+				                           { "keys", static_cast<double>( puzzle.keys.size())}};
+				size_t found = 0;
+				auto seconds = bestOf( repeats, [ &]
+				{
+					PuzzleSolver solver( grid, puzzle.keys);
+					solver.useEngine( engine);
+					solver.solve();
+					found = solver.matches().size();
+				});
+				metrics.emplace_back( "seconds", seconds);
+				metrics.emplace_back( "found", static_cast<double>( found));
+				report.add( label, metrics);
+			}
+		}
+	}
+}
+
+/*
+ * One large grid split into tiles on pools of growing size, to show how the
+ * tiled engines scale with the number of threads.
+ */
+void benchTiles( Report& report, size_t repeats)
+{
+	auto puzzle = synthesize( 2000, 500, 2024);
+	detail::PuzzleGrid grid( puzzle.rows);
+	auto cores = std::max( 1u, std::thread::hardware_concurrency());
+	for( auto [ name, engine] : { std::make_pair( "aho-corasick", PuzzleSolver::Engine::AhoCorasick),
+	                              std::make_pair( "scan", PuzzleSolver::Engine::Scan),
+	                              std::make_pair( "bitboard", PuzzleSolver::Engine::Bitboard),
+	                              std::make_pair( "packed", PuzzleSolver::Engine::Packed)})
+	{
+		double serial = 0;
+		for( size_t n_threads = 1; n_threads <= cores; n_threads *= 2)
+		{
+			detail::ThreadPool pool( n_threads);
+			size_t found = 0;
+			auto seconds = bestOf( repeats, [ &]
+			{
+				PuzzleSolver solver( grid, puzzle.keys);
+				solver.useEngine( engine);
+				solver.useThreadPool( &pool);
+				solver.solve();
+				found = solver.matches().size();
+			});
+			if( n_threads == 1)
+				serial = seconds;
+			report.add( std::string( "tiles/") + name + "/2000x2000/keys=500/threads=" + std::to_string( n_threads),
+			            {{ "threads", static_cast<double>( n_threads)}, { "seconds", seconds},
+			             { "speedup", serial / seconds}, { "found", static_cast<double>( found)}});
+		}
+	}
+}
+
+/*
+ * Play a whole animation with stdout sent to a scratch file, stdin at EOF and
+ * frames unpaced, so nothing ever waits, then divide the bytes written
+ * by the number of frames: the first full draw and one per highlighted letter.
+ */
+void benchRender( Report& report)
+{
+	auto puzzle = synthesize( 30, 20, 7);
+	char program[] = "puzzler_bench", predictable[] = "--predictable=yes";
+	char *args[] = { program, predictable};
+	detail::OptionBuilder options( 2, args);
+	options.addOption( "predictable");
+	options.build();
+	detail::EventDog::instance()->setWinSize( 100, 200);
+
+	char path[] = "/tmp/puzzler-render-XXXXXX";
+	int sink = mkstemp( path), null_input = open( "/dev/null", O_RDONLY);
+	fflush( stdout);
+	int saved_stdout = dup( STDOUT_FILENO), saved_stdin = dup( STDIN_FILENO);
+	dup2( sink, STDOUT_FILENO);
+	dup2( null_input, STDIN_FILENO);
+
+	PuzzleSolver solver( detail::PuzzleGrid( puzzle.rows), puzzle.keys);
+	solver.useEngine( PuzzleSolver::Engine::Scan);
+	TerminalPuzzleSimulator simulator( std::move( solver), options);
+	simulator.setSimulatorSpeed( INT_MAX);   // Below a millisecond per frame: unpaced.
+	auto start = Clock::now();
+	simulator.simulate( std::cout, 1, false);
+	std::cout.flush();
+	fflush( stdout);
+	auto seconds = std::chrono::duration<double>( Clock::now() - start).count();
+	auto bytes = static_cast<double>( lseek( sink, 0, SEEK_END));
+
+	dup2( saved_stdout, STDOUT_FILENO);
+	dup2( saved_stdin, STDIN_FILENO);
+	close( sink), close( null_input), close( saved_stdout), close( saved_stdin);
+	unlink( path);
+
+	PuzzleSolver reference( detail::PuzzleGrid( puzzle.rows), puzzle.keys);
+	reference.useEngine( PuzzleSolver::Engine::Scan);
+	reference.solve();
+	double frames = 1;
+	for( auto& m : reference.matches())
+		frames += static_cast<double>( m.word.size());
+	report.add( "render/terminal/30x30", {{ "frames", frames}, { "bytes", bytes},
+	                                     { "bytes_per_frame", bytes / frames},
+	                                     { "seconds_per_frame", seconds / frames}});
+}
+
+}
+
+int main( int argc, char *argv[])
+{
+	detail::OptionBuilder builder( argc, argv);
+	builder.addMismatchConsumer( []( std::string_view) {});
+	builder.addOption( "help", "h", {}, "Show this page.", 0)
+	       .addOption( "only", "o", {}, "Run a single group: `parse`, `solve` or `render`.")
+	       .addOption( "repeat", "n", "3", "Keep the best of this many runs.")
+	       .addOption( "full", "f", "no", "Also run the tracker engine on the large grids.")
+	       .addOption( "output", "O", {}, "Write the JSON report to this file instead of stdout.")
+	       .build();
+	if( !builder.asDefault( "help").empty())
+	{
+		builder.showHelp();
+		return EXIT_SUCCESS;
+	}
+
+	auto only    = builder.asDefault( "only");
+	auto repeats = static_cast<size_t>( std::max( 1L, builder.asInt( "repeat") ? builder.asInt( "repeat") : 3));
+	Report report;
+	if( only.empty() || only == "parse")
+		benchParse( report, repeats);
+	if( only.empty() || only == "solve")
+	{
+		benchSolve( report, repeats, builder.asBool( "full"));
+		benchTiles( report, repeats);
+	}
+	if( only.empty() || only == "render")
+		benchRender( report);
+
+	auto output = builder.asDefault( "output");
+	FILE *out = output.empty() ? stdout : fopen( output.c_str(), "w");
+	if( out == nullptr)
+	{
+		fprintf( stderr, "Unable to open %s\n", output.c_str());
+		return EXIT_FAILURE;
+	}
+	report.print( out);
+	if( out != stdout)
+		fclose( out);
+}
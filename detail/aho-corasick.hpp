@@ -0,0 +1,129 @@
+#ifndef PUZZLER_AHO_CORASICK_HPP
+#define PUZZLER_AHO_CORASICK_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace detail
+{
+
+/*
+ * Multi-pattern matcher over a dense goto table. Only bytes that occur in
+ * some pattern get their own column, every other byte falls back to the root.
+ */
+class AhoCorasick
+{
+public:
+	static constexpr uint32_t NO_MATCH = UINT32_MAX;
+
+	explicit AhoCorasick( const std::vector<std::string>& patterns)
+	{
+		m_class.fill( 0);
+		for( auto& pattern : patterns)
+			for( auto c : pattern)
+				if( auto& cls = m_class[ static_cast<uint8_t>( c)]; cls == 0)
+					cls = ++m_n_classes;
+		++m_n_classes;  // Class 0 is reserved for bytes that match nothing.
+
+		newNode();
+		m_lengths.reserve( patterns.size());
+		for( size_t i = 0; i < patterns.size(); ++i)
+		{
+			m_lengths.push_back( patterns[ i].size());
+			if( patterns[ i].empty())
+				continue;
+
+			uint32_t node = 0;
+			for( auto c : patterns[ i])
+			{
+				auto edge = node * m_n_classes + m_class[ static_cast<uint8_t>( c)];
+				if( m_goto[ edge] == 0)
+				{
+					auto child = newNode();   // Grows m_goto, so no reference into it is held.
+					m_goto[ edge] = child;
+				}
+				node = m_goto[ edge];
+			}
+			// Duplicate patterns report the first index.
+			if( m_output[ node] == NO_MATCH)
+				m_output[ node] = static_cast<uint32_t>( i);
+		}
+		link();
+	}
+
+	size_t patternLength( size_t pattern) const
+	{
+		return m_lengths[ pattern];
+	}
+
+	/*
+	 * Feed [begin, end) through the automaton, calling visit( pattern, position)
+	 * for every occurrence, where position is the offset of its last character.
+	 */
+	template<typename Iter, typename Visitor>
+	void scan( Iter begin, Iter end, Visitor&& visit) const
+	{
+		uint32_t node = 0;
+		for( size_t position = 0; begin != end; ++begin, ++position)
+		{
+			node = m_goto[ node * m_n_classes + m_class[ static_cast<uint8_t>( *begin)]];
+			for( auto hit = m_output[ node] != NO_MATCH ? node : m_dict[ node]; hit != 0; hit = m_dict[ hit])
+				visit( m_output[ hit], position);
+		}
+	}
+
+private:
+	uint32_t newNode()
+	{
+		m_goto.resize( m_goto.size() + m_n_classes, 0);
+		m_output.push_back( NO_MATCH);
+		m_fail.push_back( 0);
+		m_dict.push_back( 0);
+		return static_cast<uint32_t>( m_output.size() - 1);
+	}
+
+	/*
+	 * Breadth-first pass that turns the trie into a complete automaton: missing
+	 * edges borrow the fail state's edge and every node learns its nearest
+	 * proper suffix that ends a pattern.
+	 */
+	void link()
+	{
+		std::deque<uint32_t> queue;
+		for( uint32_t cls = 1; cls < m_n_classes; ++cls)
+			if( auto child = m_goto[ cls]; child != 0)
+				queue.push_back( child);
+
+		while( !queue.empty())
+		{
+			auto node = queue.front();
+			queue.pop_front();
+			auto fail = m_fail[ node];
+			m_dict[ node] = m_output[ fail] != NO_MATCH ? fail : m_dict[ fail];
+			for( uint32_t cls = 1; cls < m_n_classes; ++cls)
+			{
+				auto& child = m_goto[ node * m_n_classes + cls];
+				if( child != 0)
+				{
+					m_fail[ child] = m_goto[ fail * m_n_classes + cls];
+					queue.push_back( child);
+				}
+				else
+					child = m_goto[ fail * m_n_classes + cls];
+			}
+		}
+	}
+
+	std::array<uint32_t, 256> m_class{};
+	uint32_t m_n_classes{};
+	std::vector<uint32_t> m_goto, m_output, m_fail, m_dict;
+	std::vector<size_t> m_lengths;
+};
+
+}
+
+#endif //PUZZLER_AHO_CORASICK_HPP
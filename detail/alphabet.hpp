@@ -0,0 +1,208 @@
+#ifndef PUZZLER_ALPHABET_HPP
+#define PUZZLER_ALPHABET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * Letters of one puzzle, each as one byte. ASCII letters are their own id;
+ * any other letter is numbered from FIRST up as it first appears. Grids and
+ * keys are decoded into ids once, as they are read, so every engine compares
+ * single bytes whatever the script, and only what is shown is spelled out in
+ * UTF-8 again.
+ */
+class Alphabet
+{
+public:
+	static constexpr uint8_t FIRST    = 0x80;
+	static constexpr size_t CAPACITY  = 256 - FIRST;
+	static constexpr char32_t INVALID = 0xFFFD;
+
+	Alphabet() = default;
+
+	/*
+	 * The alphabet whose ids from FIRST up stand for `letters`.
+	 */
+	explicit Alphabet( std::vector<char32_t> letters)
+		: m_letters( std::move( letters))
+	{
+		if( m_letters.size() > CAPACITY)
+			m_letters.resize( CAPACITY);
+		for( size_t k = 0; k < m_letters.size(); ++k)
+			m_ids.emplace( m_letters[ k], static_cast<uint8_t>( FIRST + k));
+	}
+
+	bool empty() const
+	{
+		return m_letters.empty();
+	}
+
+	/*
+	 * Letters past ASCII, in the order of their ids.
+	 */
+	const std::vector<char32_t>& letters() const
+	{
+		return m_letters;
+	}
+
+	/*
+	 * Id of `letter`, numbering it if it is new; 0 once every id is taken.
+	 */
+	uint8_t idOf( char32_t letter)
+	{
+		if( letter < FIRST)
+			return static_cast<uint8_t>( letter);
+		if( auto known = m_ids.find( letter); known != m_ids.end())
+			return known->second;
+		if( m_letters.size() == CAPACITY)
+			return 0;
+		m_letters.push_back( letter);
+		return m_ids[ letter] = static_cast<uint8_t>( FIRST + m_letters.size() - 1);
+	}
+
+	/*
+	 * Append the UTF-8 spelling of the ids in `cells` to `out`.
+	 */
+	void spell( std::string_view cells, std::string& out) const
+	{
+		for( auto c : cells)
+		{
+			auto id = static_cast<uint8_t>( c);
+			if( id >= FIRST && id - FIRST < static_cast<int>( m_letters.size()))
+				encode( m_letters[ id - FIRST], out);
+			else
+				out += c;
+		}
+	}
+
+	/*
+	 * Code point starting at `text[ i]`, moving `i` past it; INVALID, having
+	 * moved past one byte, where `text` is not UTF-8.
+	 */
+	static char32_t decode( std::string_view text, size_t& i)
+	{
+		auto lead = static_cast<uint8_t>( text[ i]);
+		auto size = static_cast<size_t>( util::byteCount( lead));
+		if( size == 1 || size > 4 || size > text.size() - i)
+		{
+			++i;
+			return lead < 0x80 ? lead : INVALID;
+		}
+
+		char32_t code = lead & ( 0x7Fu >> size);
+		for( size_t k = 1; k < size; ++k)
+		{
+			auto next = static_cast<uint8_t>( text[ i + k]);
+			if( ( next & 0xC0) != 0x80)
+			{
+				++i;
+				return INVALID;
+			}
+			code = code << 6 | ( next & 0x3Fu);
+		}
+		i += size;
+		return code;
+	}
+
+	static void encode( char32_t code, std::string& out)
+	{
+		if( code < 0x80)
+			out += static_cast<char>( code);
+		else if( code < 0x800)
+		{
+			out += static_cast<char>( 0xC0 | code >> 6);
+			out += static_cast<char>( 0x80 | ( code & 0x3F));
+		}
+		else if( code < 0x10000)
+		{
+			out += static_cast<char>( 0xE0 | code >> 12);
+			out += static_cast<char>( 0x80 | ( code >> 6 & 0x3F));
+			out += static_cast<char>( 0x80 | ( code & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>( 0xF0 | code >> 18);
+			out += static_cast<char>( 0x80 | ( code >> 12 & 0x3F));
+			out += static_cast<char>( 0x80 | ( code >> 6 & 0x3F));
+			out += static_cast<char>( 0x80 | ( code & 0x3F));
+		}
+	}
+
+	/*
+	 * Whether `code` is a letter of the alphabetic scripts puzzles are
+	 * written in: Latin, Greek, Cyrillic, Armenian, Georgian, Hebrew and
+	 * Arabic. Precomposed letters only; combining marks are not letters.
+	 */
+	static bool isLetter( char32_t code)
+	{
+		static constexpr std::pair<char32_t, char32_t> LETTERS[] = {
+			{ 'A', 'Z'}, { 'a', 'z'}, { 0xAA, 0xAA}, { 0xB5, 0xB5}, { 0xBA, 0xBA},
+			{ 0xC0, 0xD6}, { 0xD8, 0xF6}, { 0xF8, 0x2AF},                         // Latin-1, Latin Extended, IPA
+			{ 0x370, 0x373}, { 0x376, 0x377}, { 0x37B, 0x37D}, { 0x37F, 0x37F},
+			{ 0x386, 0x386}, { 0x388, 0x3F5}, { 0x3F7, 0x3FF},                    // Greek
+			{ 0x400, 0x481}, { 0x48A, 0x52F},                                     // Cyrillic
+			{ 0x531, 0x556}, { 0x561, 0x587},                                     // Armenian
+			{ 0x5D0, 0x5EA}, { 0x620, 0x64A},                                     // Hebrew, Arabic
+			{ 0x10A0, 0x10FF}, { 0x1E00, 0x1FBC}                                  // Georgian, Latin and Greek Extended
+		};
+		for( auto [ first, last] : LETTERS)
+			if( code >= first && code <= last)
+				return true;
+		return false;
+	}
+
+	/*
+	 * Upper case of the letter `code`, where it is a single letter; others,
+	 * such as ß, stay as they are.
+	 */
+	static char32_t upper( char32_t code)
+	{
+		auto odd  = ( code & 1) != 0;
+		auto in   = [ code]( char32_t first, char32_t last) { return code >= first && code <= last; };
+		if( in( 'a', 'z') || ( in( 0xE0, 0xFE) && code != 0xF7) || in( 0x3B1, 0x3C1) || in( 0x3C3, 0x3CB) || in( 0x430, 0x44F))
+			return code - 0x20;
+		switch( code)
+		{
+			case 0xFF:  return 0x178;
+			case 0x131: return 'I';
+			case 0x17F: return 'S';
+			case 0x3C2: return 0x3A3;
+			case 0x3AC: return 0x386;
+			case 0x3CC: return 0x38C;
+			case 0x4CF: return 0x4C0;
+			default:    break;
+		}
+		if( in( 0x3AD, 0x3AF))
+			return code - 0x25;
+		if( in( 0x3CD, 0x3CE))
+			return code - 0x3F;
+		if( in( 0x450, 0x45F))
+			return code - 0x50;
+		if( in( 0x561, 0x586))
+			return code - 0x30;
+		// Pairs of an upper case letter followed by its lower case.
+		if( in( 0x139, 0x148) || in( 0x179, 0x17E) || in( 0x4C1, 0x4CE))
+			return odd ? code : code - 1;
+		if( ( in( 0x100, 0x177) && code != 0x130 && code != 0x138 && code != 0x149) || in( 0x460, 0x481) || in( 0x48A, 0x4BF)
+		    || in( 0x4D0, 0x52F) || in( 0x1E00, 0x1E95) || in( 0x1EA0, 0x1EFF))
+			return odd ? code - 1 : code;
+		return code;
+	}
+
+private:
+	std::vector<char32_t> m_letters;
+	std::unordered_map<char32_t, uint8_t> m_ids;
+};
+
+}
+
+#endif //PUZZLER_ALPHABET_HPP
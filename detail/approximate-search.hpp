@@ -0,0 +1,484 @@
+#ifndef PUZZLER_APPROXIMATE_SEARCH_HPP
+#define PUZZLER_APPROXIMATE_SEARCH_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "direction-lines.hpp"
+#include "puzzle-grid.hpp"
+#include "thread-pool.hpp"
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * One pattern matched with up to a given number of edits (letters replaced,
+ * left out or put in) by the edit distance table, a column per text letter.
+ * `?` in the pattern stands for any letter. It places the matches
+ * PackedMatcher finds, and finds those of patterns too long for it.
+ */
+class ApproximateMatcher
+{
+public:
+	static constexpr char WILDCARD = '?';
+
+	explicit ApproximateMatcher( std::string_view pattern)
+		: m_pattern( pattern)
+	{
+		std::transform( m_pattern.cbegin(), m_pattern.cend(), m_pattern.begin(), []( char c)
+		{
+			return c >= 'a' && c <= 'z' ? static_cast<char>( c - 'a' + 'A') : c;
+		});
+	}
+
+	const std::string& pattern() const
+	{
+		return m_pattern;
+	}
+
+	/*
+	 * Feed [begin, end) through the matcher, calling visit( position, errors)
+	 * wherever the pattern ends with at most `limit` errors, position being
+	 * the offset of the last letter.
+	 */
+	template<typename Iter, typename Visitor>
+	void scan( Iter begin, Iter end, size_t limit, Visitor&& visit) const
+	{
+		auto m = m_pattern.size();
+		std::vector<size_t> column( m + 1);
+		std::iota( column.begin(), column.end(), size_t{ 0});
+		for( size_t position = 0; begin != end; ++begin, ++position)
+		{
+			size_t diagonal = 0;    // The top row stays 0: a match may start anywhere.
+			for( size_t i = 1; i <= m; ++i)
+			{
+				auto above = column[ i];
+				column[ i] = std::min( { above + 1, column[ i - 1] + 1, diagonal + !matches( i - 1, *begin)});
+				diagonal = above;
+			}
+			if( column[ m] <= limit)
+				visit( position, column[ m]);
+		}
+	}
+
+	/*
+	 * Offset of the first letter of the closest match, with at most `errors`
+	 * edits, that ends at `position` of the text starting at `begin`. Of the
+	 * alignments with as few edits, the one spanning the length closest to
+	 * the pattern's wins.
+	 */
+	template<typename Iter>
+	size_t start( Iter begin, size_t position, size_t errors) const
+	{
+		// Align the reversed pattern with the text read back from `position`.
+		auto m = m_pattern.size();
+		auto span = std::min( position + 1, m + errors);
+		std::vector<size_t> column( m + 1);
+		std::iota( column.begin(), column.end(), size_t{ 0});
+		size_t best = 0, fewest = errors + 1;
+		for( size_t j = 1; j <= span; ++j)
+		{
+			auto letter = *( begin + static_cast<std::ptrdiff_t>( position + 1 - j));
+			auto diagonal = column[ 0];
+			column[ 0] = j;
+			for( size_t i = 1; i <= m; ++i)
+			{
+				auto above = column[ i];
+				column[ i] = std::min( { above + 1, column[ i - 1] + 1, diagonal + !matches( m - i, letter)});
+				diagonal = above;
+			}
+			if( column[ m] < fewest || ( column[ m] == fewest && distance( j, m) < distance( best, m)))
+			{
+				best   = j;
+				fewest = column[ m];
+			}
+		}
+		return position + 1 - std::max<size_t>( best, 1);
+	}
+
+private:
+	bool matches( size_t i, char letter) const
+	{
+		return m_pattern[ i] == letter || m_pattern[ i] == WILDCARD;
+	}
+
+	static size_t distance( size_t a, size_t b)
+	{
+		return a > b ? a - b : b - a;
+	}
+
+	std::string m_pattern;
+};
+
+/*
+ * Several patterns of up to 64 letters matched at once by Myers' bit-vector
+ * algorithm: a column of the edit distance table is held as bits of a 64 bit
+ * word and advanced a text letter at a time with a dozen word operations.
+ * Each pattern takes a field of `width` bits of the word, its letters at the
+ * top; the rows below it match anything and start at distance 0, so a match
+ * may start anywhere whatever the pattern's length. Carries are kept from
+ * crossing into the next field, and every pattern's distance is counted in
+ * its field of a word of its own, offset so that the field's top bit clears
+ * while the distance is within the pattern's limit.
+ */
+class PackedMatcher
+{
+public:
+	static constexpr size_t MAX_LENGTH = 64;
+
+	struct State
+	{
+		uint64_t pv, mv,    // Vertical deltas of the column, +1 and -1.
+		         errors;    // Distance of each pattern, offset.
+	};
+
+	explicit PackedMatcher( unsigned width)
+		: m_width( width)
+	{
+		m_equal.fill( 0);
+	}
+
+	/*
+	 * Narrowest field that holds `length` letters, out of those that leave
+	 * the fewest bits of a word unused.
+	 */
+	static unsigned widthFor( size_t length)
+	{
+		for( unsigned width : { 8, 10, 12, 16, 21, 32})
+			if( length <= width)
+				return width;
+		return MAX_LENGTH;
+	}
+
+	size_t size() const
+	{
+		return m_limits.size();
+	}
+
+	size_t capacity() const
+	{
+		return MAX_LENGTH / m_width;
+	}
+
+	unsigned width() const
+	{
+		return m_width;
+	}
+
+	/*
+	 * Add `pattern`, already upper-cased, whose matches with up to `limit`
+	 * errors are wanted.
+	 */
+	void add( std::string_view pattern, size_t limit)
+	{
+		auto base = size() * m_width, pad = m_width - pattern.size();
+		for( size_t row = 0; row < m_width; ++row)
+		{
+			auto bit = uint64_t{ 1} << ( base + row);
+			if( row < pad || pattern[ row - pad] == ApproximateMatcher::WILDCARD)
+				for( auto& equal : m_equal)
+					equal |= bit;
+			else
+				m_equal[ static_cast<uint8_t>( pattern[ row - pad])] |= bit;
+			if( row >= pad)
+				m_start.pv |= bit;
+		}
+		m_top    |= uint64_t{ 1} << ( base + m_width - 1);
+		m_bottom |= uint64_t{ 1} << base;
+		m_limits.push_back( limit);
+		m_start.errors += ( pattern.size() + offset( size() - 1)) << base;
+	}
+
+	State state() const
+	{
+		return m_start;
+	}
+
+	/*
+	 * Advance `s` past `letter`; the top bits of the fields whose patterns
+	 * end there within their limit.
+	 */
+	uint64_t step( State& s, char letter) const
+	{
+		auto eq  = m_equal[ static_cast<uint8_t>( letter)];
+		auto xv  = eq | s.mv;
+		auto sum = eq & s.pv;
+		sum      = ( ( sum & ~m_top) + ( s.pv & ~m_top)) ^ ( ( sum ^ s.pv) & m_top);
+		auto xh  = ( sum ^ s.pv) | eq;
+		auto ph  = s.mv | ~( xh | s.pv);
+		auto mh  = s.pv & xh;
+		s.errors += ( ph & m_top) >> ( m_width - 1);
+		s.errors -= ( mh & m_top) >> ( m_width - 1);
+		// Nothing shifts into a field: its bottom row is free.
+		ph   = ( ph << 1) & ~m_bottom;
+		mh   = ( mh << 1) & ~m_bottom;
+		s.pv = mh | ~( xv | ph);
+		s.mv = ph & xv;
+		return ~s.errors & m_top;
+	}
+
+	/*
+	 * Field of the lowest of `hits`.
+	 */
+	size_t fieldOf( uint64_t hits) const
+	{
+		return static_cast<size_t>( __builtin_ctzll( hits)) / m_width;
+	}
+
+	size_t errors( const State& s, size_t field) const
+	{
+		auto mask = m_width == MAX_LENGTH ? ~uint64_t{ 0} : ( uint64_t{ 1} << m_width) - 1;
+		return ( s.errors >> field * m_width & mask) - offset( field);
+	}
+
+private:
+	uint64_t offset( size_t field) const
+	{
+		return ( uint64_t{ 1} << ( m_width - 1)) - m_limits[ field] - 1;
+	}
+
+	unsigned m_width;
+	std::array<uint64_t, 256> m_equal;    // Bit of each row whose letter matches.
+	uint64_t m_top{}, m_bottom{};         // Top and bottom row of every field.
+	State m_start{};
+	std::vector<size_t> m_limits;
+};
+
+/*
+ * Best approximate placement of keys in a grid. Every key is matched as
+ * written along each row, column and diagonal, and reversed, which finds it
+ * read against the line. Keys of about the same length are packed into the
+ * fields of a few PackedMatchers that are stepped side by side, so one pass
+ * over the lines serves up to 16 keys.
+ */
+class ApproximateSearch
+{
+public:
+	struct Match
+	{
+		int row{ -1}, col{ -1};              // First letter of the key.
+		Dir direction{ Dir::NL};
+		size_t errors{};
+		bool reversed{};                     // Found by the reversed key's pass.
+		int line_row{ -1}, line_col{ -1};    // First letter matched along the line.
+
+		bool found() const
+		{
+			return direction != Dir::NL;
+		}
+
+		/*
+		 * Fewer errors first, then as PuzzleSolver::Placement orders exact
+		 * matches: forward ones, the earlier start along the line in scan
+		 * order and the lowest direction of the line.
+		 */
+		bool preferredTo( const Match& other) const
+		{
+			if( !other.found())
+				return found();
+			return found() && std::make_tuple( errors, reversed, line_row, line_col, static_cast<int>( lineDirection()))
+			                  < std::make_tuple( other.errors, other.reversed, other.line_row, other.line_col,
+			                                     static_cast<int>( other.lineDirection()));
+		}
+
+		Dir lineDirection() const
+		{
+			return reversed ? opposite( direction) : direction;
+		}
+	};
+
+	explicit ApproximateSearch( const PuzzleGrid& grid)
+		: m_lines( grid), m_cells( grid.rows() * grid.cols())
+	{
+	}
+
+	/*
+	 * Share out the keys of large grids between the threads of `pool`, which
+	 * has to outlive every call to best().
+	 */
+	void useThreadPool( ThreadPool *pool)
+	{
+		m_pool = pool;
+	}
+
+	/*
+	 * Best placement of each of `keys` with at most `max_errors` edits; a key
+	 * is allowed fewer edits than it has letters, else it would fit anywhere.
+	 */
+	std::vector<Match> best( const std::vector<std::string_view>& keys, size_t max_errors) const
+	{
+		std::vector<Keyed> keyed;
+		for( size_t key = 0; key < keys.size(); ++key)
+			if( !keys[ key].empty())
+				keyed.push_back( { key, ApproximateMatcher( keys[ key]), ApproximateMatcher( util::reversed( std::string( keys[ key]))),
+				                   std::min( max_errors, keys[ key].size() - 1)});
+
+		// A key and its reversal go to the same group, so no two groups place the same key.
+		std::vector<Group> groups;
+		std::vector<size_t> order( keyed.size());
+		std::iota( order.begin(), order.end(), size_t{ 0});
+		std::stable_sort( order.begin(), order.end(), [ &]( size_t left, size_t right)
+		{
+			return keyed[ left].forward.pattern().size() < keyed[ right].forward.pattern().size();
+		});
+		for( auto k : order)
+		{
+			auto length = keyed[ k].forward.pattern().size();
+			if( length > PackedMatcher::MAX_LENGTH)
+			{
+				groups.push_back( { {}, {}, k});
+				continue;
+			}
+			auto width = PackedMatcher::widthFor( length);
+			if( groups.empty() || groups.back().words.empty() || groups.back().words.back().width() != width
+			    || ( groups.back().words.size() == GROUP && groups.back().words.back().size() + 2 > groups.back().words.back().capacity()))
+				groups.emplace_back();
+			auto& group = groups.back();
+			for( auto backward : { false, true})
+			{
+				if( group.words.empty() || group.words.back().size() == group.words.back().capacity())
+				{
+					group.words.emplace_back( width);
+					group.slots.emplace_back();
+				}
+				const auto& pattern = backward ? keyed[ k].backward.pattern() : keyed[ k].forward.pattern();
+				group.words.back().add( pattern, keyed[ k].limit);
+				group.slots.back().push_back( { k, backward});
+			}
+		}
+
+		std::vector<Match> found( keys.size());
+		auto search = [ &]( size_t group) { searchGroup( groups[ group], keyed, found); };
+		if( m_pool && groups.size() > 1 && m_cells >= PARALLEL_CELLS)
+			m_pool->parallelFor( groups.size(), search);
+		else
+			for( size_t group = 0; group < groups.size(); ++group)
+				search( group);
+		return found;
+	}
+
+private:
+	static constexpr size_t GROUP          = 4;
+	static constexpr size_t PARALLEL_CELLS = 1 << 16;
+	static constexpr size_t NONE           = SIZE_MAX;
+
+	struct Keyed
+	{
+		size_t key;
+		ApproximateMatcher forward, backward;    // The key, and the key reversed.
+		size_t limit;
+	};
+
+	struct Slot
+	{
+		size_t keyed;
+		bool backward;
+	};
+
+	/*
+	 * Up to GROUP matchers searched in one pass, and the pattern in each of
+	 * their fields; or a single key too long to pack.
+	 */
+	struct Group
+	{
+		std::vector<PackedMatcher> words;
+		std::vector<std::vector<Slot>> slots;
+		size_t single{ NONE};
+	};
+
+	void searchGroup( const Group& group, const std::vector<Keyed>& keyed, std::vector<Match>& found) const
+	{
+		switch( group.words.size())
+		{
+			case 1:  searchPacked<1>( group, keyed, found); break;
+			case 2:  searchPacked<2>( group, keyed, found); break;
+			case 3:  searchPacked<3>( group, keyed, found); break;
+			case 4:  searchPacked<4>( group, keyed, found); break;
+			default: searchLong( keyed[ group.single], found[ keyed[ group.single].key]); break;
+		}
+	}
+
+	template<size_t N>
+	void searchPacked( const Group& group, const std::vector<Keyed>& keyed, std::vector<Match>& found) const
+	{
+		for( const auto& line : m_lines.lines())
+		{
+			auto text = m_lines.text( line);
+			std::array<PackedMatcher::State, N> states;
+			for( size_t w = 0; w < N; ++w)
+				states[ w] = group.words[ w].state();
+			for( size_t position = 0; position < text.size(); ++position)
+			{
+				auto letter = text[ position];
+				for( size_t w = 0; w < N; ++w)
+				{
+					const auto& word = group.words[ w];
+					for( auto hits = word.step( states[ w], letter); hits != 0; hits &= hits - 1)
+					{
+						auto field = word.fieldOf( hits);
+						auto slot  = group.slots[ w][ field];
+						auto& k    = keyed[ slot.keyed];
+						place( found[ k.key], line, text, k, slot.backward, position, word.errors( states[ w], field));
+					}
+				}
+			}
+		}
+	}
+
+	void searchLong( const Keyed& k, Match& placed) const
+	{
+		for( const auto& line : m_lines.lines())
+		{
+			auto text = m_lines.text( line);
+			for( auto backward : { false, true})
+				( backward ? k.backward : k.forward).scan( text.cbegin(), text.cend(), k.limit, [ &]( size_t end, size_t errors)
+				{
+					place( placed, line, text, k, backward, end, errors);
+				});
+		}
+	}
+
+	/*
+	 * Offer the match of `k`, or of its reversal, with `errors` edits that
+	 * ends at `end` of `line`. A reversal starts at the key's last letter;
+	 * from there its first one is picked as for a key read along the line.
+	 */
+	static void place( Match& placed, const DirectionLines::Line& line, std::string_view text, const Keyed& k,
+	                   bool backward, size_t end, size_t errors)
+	{
+		// A single letter reads the same both ways; it is placed once, forward.
+		if( ( placed.found() && errors > placed.errors) || ( backward && k.forward.pattern().size() == 1))
+			return;
+		size_t first, along;
+		if( backward)
+		{
+			along = k.backward.start( text.cbegin(), end, errors);
+			first = text.size() - 1 - k.forward.start( text.crbegin(), text.size() - 1 - along, errors);
+		}
+		else
+			first = along = k.forward.start( text.cbegin(), end, errors);
+
+		auto offset = static_cast<int>( first), line_offset = static_cast<int>( along);
+		Match candidate{ line.x + offset * line.dx, line.y + offset * line.dy,
+		                 backward ? opposite( line.direction) : line.direction, errors, backward,
+		                 line.x + line_offset * line.dx, line.y + line_offset * line.dy};
+		if( candidate.preferredTo( placed))
+			placed = candidate;
+	}
+
+	DirectionLines m_lines;
+	size_t m_cells;
+	ThreadPool *m_pool{};
+};
+
+}
+
+#endif //PUZZLER_APPROXIMATE_SEARCH_HPP
@@ -0,0 +1,324 @@
+#ifndef PUZZLER_BATCH_SOLVER_HPP
+#define PUZZLER_BATCH_SOLVER_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "approximate-search.hpp"
+#include "puzzle-solver.hpp"
+#include "puzzle-reader.hpp"
+#include "puzzle-feed.hpp"
+#include "thread-pool.hpp"
+#include "word-trie.hpp"
+
+namespace detail
+{
+
+/*
+ * Solves every puzzle of a file without the simulator and streams the matches
+ * out as JSON lines or CSV records. Puzzles are solved concurrently as soon as
+ * they are parsed but are always written in the order they appear in the file.
+ * Only a few puzzles per thread are in flight at once, and those that stream
+ * every occurrence hold back a chunk of records at most, which bounds the
+ * memory held by results that are waiting for their turn.
+ */
+class BatchSolver
+{
+public:
+	enum class Format
+	{
+		Json,
+		Csv
+	};
+
+	BatchSolver( std::ostream& strm, Format format, PuzzleSolver::Engine engine, size_t n_threads = 0)
+		: m_strm( strm), m_format( format), m_engine( engine), m_pool( n_threads)
+	{
+	}
+
+	/*
+	 * Report every occurrence of every key rather than one match per key.
+	 */
+	void allOccurrences( bool all)
+	{
+		m_all = all;
+	}
+
+	/*
+	 * Look for every word of `dictionary` instead of each puzzle's keys. The
+	 * mapped trie is shared by every task.
+	 */
+	void useDictionary( std::shared_ptr<const WordTrie> dictionary)
+	{
+		m_dictionary = std::move( dictionary);
+	}
+
+	/*
+	 * Report the best placement of each key with at most `errors` edits, and
+	 * how many it took, instead of its exact matches. Keys may hold `?`
+	 * wildcards. These runs are not cached either.
+	 */
+	void maxErrors( std::optional<size_t> errors)
+	{
+		m_max_errors = errors;
+	}
+
+	/*
+	 * Take the matches of puzzles solved before from `cache`, and keep the
+	 * others there. Occurrence and dictionary runs are not cached.
+	 */
+	void useCache( SolutionCache *cache)
+	{
+		m_cache = cache;
+	}
+
+	void solve( PuzzleFeed& feed)
+	{
+		if( m_format == Format::Csv)
+			m_strm << "puzzle,word,row,col,direction,reversed" << ( m_max_errors ? ",errors\n" : "\n");
+
+		const auto max_in_flight = 4 * m_pool.size();
+		for( size_t i = 0; auto image = feed.get( i); ++i)
+		{
+			size_t written;
+			{
+				std::unique_lock<std::mutex> lock( m_mutex);
+				m_written.wait( lock, [ &] { return i - m_next < max_in_flight; });
+				written = m_next;
+			}
+			// Puzzles are only delivered once their tasks are done with them.
+			feed.release( written);
+			m_pool.submit( [ this, i, &image = *image]
+			               {
+				               if( m_dictionary)
+				               {
+					               streamRecords( i, [ &]( auto&& emit)
+					               {
+						               m_dictionary->search( image.puzzle, [ &]( uint32_t word, int row, int col, Dir direction)
+						               {
+							               emit( m_dictionary->word( word), row, col, direction);
+						               });
+					               });
+					               return;
+				               }
+				               if( m_max_errors)
+				               {
+					               ApproximateSearch search( image.puzzle);
+					               search.useThreadPool( &m_pool);
+					               deliver( i, format( i + 1, image, search.best( image.keys, *m_max_errors)));
+					               return;
+				               }
+				               if( m_all)
+				               {
+					               PuzzleSolver solver( image.puzzle, image.keys);
+					               std::vector<std::string> spelled;
+					               for( auto& w : solver.words())
+						               spelled.push_back( image.puzzle.spell( w));
+					               streamRecords( i, [ &]( auto&& emit)
+					               {
+						               solver.forEachOccurrence( [ &]( const PuzzleSolver::Occurrence& o)
+						               {
+							               emit( spelled[ o.key], o.row, o.col, o.direction);
+						               });
+					               });
+					               return;
+				               }
+				               PuzzleSolver solver( image.puzzle, image.keys);
+				               solver.useEngine( m_engine);
+				               // Large grids are also split into tiles on the same pool.
+				               solver.useThreadPool( &m_pool);
+				               solver.useCache( m_cache);
+				               solver.useKnownSolution( image.solution);
+				               solver.solve();
+				               deliver( i, format( i + 1, solver));
+			               });
+		}
+		m_pool.wait();
+		m_strm.flush();
+	}
+
+	/*
+	 * Most output bytes held back at once while waiting for earlier puzzles.
+	 */
+	size_t peakHeldBytes() const
+	{
+		std::lock_guard<std::mutex> lock( m_mutex);
+		return m_peak_held;
+	}
+
+	static std::optional<Format> parseFormat( std::string_view name)
+	{
+		// A bare `--batch` picks the default format.
+		if( name.empty() || name == "batch" || name == "json")
+			return Format::Json;
+		else if( name == "csv")
+			return Format::Csv;
+		return std::nullopt;
+	}
+
+private:
+	std::string format( size_t puzzle_number, const PuzzleSolver& solver) const
+	{
+		// Words are ordered by their text, not by the ids of letters past ASCII. A key and
+		// its reversal read the same along their line; the one found forward comes first.
+		const auto& grid = solver.puzzle();
+		std::vector<std::pair<std::string, PuzzleSolver::underlying_type>> ordered;
+		for( auto& m : solver.matches())
+			ordered.emplace_back( grid.spell( m.word), m);
+		std::sort( ordered.begin(), ordered.end(), []( auto& left, auto& right)
+		           { return std::tie( left.first, left.second.reversed) < std::tie( right.first, right.second.reversed); });
+
+		std::ostringstream out;
+		for( auto& [ text, m] : ordered)
+		{
+			// Report the key as written: reversed matches are walked back to the key's first letter.
+			auto word = grid.spell( m.reversed ? util::reversed( m.word) : m.word);
+			auto start = m.start;
+			auto direction = m.dmatch;
+			if( m.reversed)
+			{
+				for( size_t i = 1; i < m.word.size(); ++i)
+					start = PuzzleSolver::next( m.dmatch, start);
+				direction = opposite( m.dmatch);
+			}
+
+			record( out, puzzle_number, word, start.x, start.y, direction, m.reversed);
+		}
+		return out.str();
+	}
+
+	/*
+	 * Records of the keys placed within the allowed errors, ordered like
+	 * exact ones by the key as it reads along the line it was found on.
+	 */
+	std::string format( size_t puzzle_number, const PuzzleImage& image, const std::vector<ApproximateSearch::Match>& found) const
+	{
+		std::vector<std::tuple<std::string, std::string, ApproximateSearch::Match>> ordered;
+		for( size_t key = 0; key < found.size(); ++key)
+			if( found[ key].found())
+			{
+				auto pattern = ApproximateMatcher( image.keys[ key]).pattern();
+				ordered.emplace_back( image.puzzle.spell( found[ key].reversed ? util::reversed( pattern) : pattern),
+				                      image.puzzle.spell( pattern), found[ key]);
+			}
+		std::sort( ordered.begin(), ordered.end(), []( auto& left, auto& right)
+		           { return std::tie( std::get<0>( left), std::get<2>( left).reversed)
+		                    < std::tie( std::get<0>( right), std::get<2>( right).reversed); });
+
+		std::ostringstream out;
+		for( auto& [ along, word, m] : ordered)
+			record( out, puzzle_number, word, m.row, m.col, m.direction, m.reversed, m.errors);
+		return out.str();
+	}
+
+	// Keys read against scan order are the ones the reversed-word pass finds.
+	static bool isBackward( Dir direction)
+	{
+		return direction == Dir::NT || direction == Dir::WT || direction == Dir::NE || direction == Dir::NW;
+	}
+
+	/*
+	 * Write out the records `search( emit)` produces as they come, a chunk at
+	 * a time. A puzzle whose turn has not come yet holds on to one chunk at
+	 * most and then waits for every earlier puzzle to be written. These tasks
+	 * never wait for other tasks of the pool, so the puzzle that is next in
+	 * line is always running or about to.
+	 */
+	template<typename Search>
+	void streamRecords( size_t index, Search&& search)
+	{
+		std::ostringstream out;
+		search( [ &]( std::string_view word, int row, int col, Dir direction)
+		{
+			record( out, index + 1, word, row, col, direction, isBackward( direction));
+			if( out.tellp() >= static_cast<std::streamoff>( CHUNK_BYTES))
+			{
+				auto chunk = out.str();
+				out.str( {});
+				std::unique_lock<std::mutex> lock( m_mutex);
+				if( m_next != index)
+				{
+					hold( chunk.size());
+					m_written.wait( lock, [ &] { return m_next == index; });
+					m_held -= chunk.size();
+				}
+				m_strm << chunk;
+			}
+		});
+		deliver( index, out.str());
+	}
+
+	void record( std::ostream& out, size_t puzzle_number, std::string_view word, int row, int col,
+	             Dir direction, bool reversed, size_t errors = 0) const
+	{
+		if( m_format == Format::Json)
+		{
+			out << "{\"puzzle\":" << puzzle_number << ",\"word\":\"" << word
+			    << "\",\"row\":" << row << ",\"col\":" << col
+			    << ",\"direction\":\"" << dirName( direction)
+			    << "\",\"reversed\":" << ( reversed ? "true" : "false");
+			if( m_max_errors)
+				out << ",\"errors\":" << errors;
+			out << "}\n";
+		}
+		else
+		{
+			out << puzzle_number << ',' << word << ',' << row << ',' << col << ','
+			    << dirName( direction) << ',' << ( reversed ? "true" : "false");
+			if( m_max_errors)
+				out << ',' << errors;
+			out << '\n';
+		}
+	}
+
+	/*
+	 * Hand over the output of a solved puzzle and flush every result that is
+	 * now contiguous with what has already been written.
+	 */
+	void deliver( size_t index, std::string result)
+	{
+		std::lock_guard<std::mutex> lock( m_mutex);
+		hold( result.size());
+		m_pending.emplace( index, std::move( result));
+		for( auto ready = m_pending.begin(); ready != m_pending.end() && ready->first == m_next;
+		     ready = m_pending.erase( ready), ++m_next)
+		{
+			m_strm << ready->second;
+			m_held -= ready->second.size();
+		}
+		// Both solve() and the tasks streaming records may be waiting.
+		m_written.notify_all();
+	}
+
+	void hold( size_t bytes)
+	{
+		m_held += bytes;
+		m_peak_held = std::max( m_peak_held, m_held);
+	}
+
+	static constexpr size_t CHUNK_BYTES = 1 << 16;
+
+	std::ostream& m_strm;
+	Format m_format;
+	PuzzleSolver::Engine m_engine;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_written;
+	std::map<size_t, std::string> m_pending;
+	size_t m_next{}, m_held{}, m_peak_held{};
+	bool m_all{};
+	std::optional<size_t> m_max_errors;
+	std::shared_ptr<const WordTrie> m_dictionary;
+	SolutionCache *m_cache{};
+	ThreadPool m_pool;
+};
+
+}
+
+#endif //PUZZLER_BATCH_SOLVER_HPP
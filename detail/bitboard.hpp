@@ -0,0 +1,121 @@
+#ifndef PUZZLER_BITBOARD_HPP
+#define PUZZLER_BITBOARD_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "puzzle-grid.hpp"
+
+namespace detail
+{
+
+/*
+ * One bitboard per letter used by the keys, with a bit for every cell of the
+ * grid. Rows are padded to whole 64-bit words, so stepping a key along a
+ * column offset is a word-wide shift and along a row offset a change of row.
+ */
+class LetterBoards
+{
+public:
+	LetterBoards( const PuzzleGrid& grid, const std::vector<std::string>& keys)
+		: m_rows( grid.rows()), m_cols( grid.cols()), m_words(( grid.cols() + 63) / 64)
+	{
+		m_index.fill( ABSENT);
+		uint16_t n_boards = 0;
+		for( auto& key : keys)
+			for( auto c : key)
+				if( auto& index = m_index[ static_cast<uint8_t>( c)]; index == ABSENT)
+					index = n_boards++;
+
+		m_bits.assign( size_t{ n_boards} * m_rows * m_words, 0);
+		for( size_t i = 0; i < m_rows; ++i)
+		{
+			auto row = grid.row( i);
+			for( size_t j = 0; j < m_cols; ++j)
+				if( auto index = m_index[ static_cast<uint8_t>( row[ j])]; index != ABSENT)
+					m_bits[ ( index * m_rows + i) * m_words + j / 64] |= uint64_t{ 1} << ( j % 64);
+		}
+	}
+
+	/*
+	 * First cell, in row-major order and above `row_limit`, from which `key`
+	 * reads along the offset ( dx, dy). Every start cell of a row is tested at
+	 * once by ANDing the boards of the key's letters, the i-th one taken i
+	 * steps further along the direction.
+	 */
+	std::optional<std::pair<size_t, size_t>> firstMatch( const std::string& key, int dx, int dy,
+	                                                      size_t row_limit = SIZE_MAX) const
+	{
+		for( auto c : key)
+			if( m_index[ static_cast<uint8_t>( c)] == ABSENT)
+				return std::nullopt;
+
+		// Start cells that keep the whole key on the grid.
+		auto span = static_cast<long>( key.size()) - 1,
+		     rows = static_cast<long>( m_rows), cols = static_cast<long>( m_cols);
+		auto row_lo = std::max( 0L, -span * dx), row_hi = std::min( rows - std::max( 0L, span * dx),
+		                                                             static_cast<long>( std::min( row_limit, m_rows)));
+		auto col_lo = std::max( 0L, -span * dy), col_hi = cols - std::max( 0L, span * dy);
+		if( row_lo >= row_hi || col_lo >= col_hi)
+			return std::nullopt;
+
+		std::vector<uint64_t> columns( m_words, 0), acc( m_words);
+		for( auto j = col_lo; j < col_hi; ++j)
+			columns[ static_cast<size_t>( j) / 64] |= uint64_t{ 1} << ( j % 64);
+
+		for( auto r = row_lo; r < row_hi; ++r)
+		{
+			acc = columns;
+			uint64_t any = 1;
+			for( long i = 0; any && i <= span; ++i)
+			{
+				auto board = row( key[ static_cast<size_t>( i)], static_cast<size_t>( r + i * dx));
+				any = 0;
+				for( size_t w = 0; w < m_words; ++w)
+					any |= ( acc[ w] &= shifted( board, w, i * dy));
+			}
+			if( !any)
+				continue;
+
+			for( size_t w = 0; w < m_words; ++w)
+				if( acc[ w])
+					return std::make_pair( static_cast<size_t>( r), w * 64 + static_cast<size_t>( __builtin_ctzll( acc[ w])));
+		}
+		return std::nullopt;
+	}
+
+private:
+	static constexpr uint16_t ABSENT = UINT16_MAX;
+
+	const uint64_t *row( char letter, size_t i) const
+	{
+		return m_bits.data() + ( m_index[ static_cast<uint8_t>( letter)] * m_rows + i) * m_words;
+	}
+
+	// Word `w` of the row moved so that bit j holds what was at column j + shift.
+	uint64_t shifted( const uint64_t *board, size_t w, long shift) const
+	{
+		auto word = [ &]( long k) { return k >= 0 && k < static_cast<long>( m_words) ? board[ k] : 0; };
+		auto at   = static_cast<long>( w);
+		if( shift >= 0)
+		{
+			auto q = shift / 64, b = shift % 64;
+			return b == 0 ? word( at + q) : word( at + q) >> b | word( at + q + 1) << ( 64 - b);
+		}
+		auto q = -shift / 64, b = -shift % 64;
+		return b == 0 ? word( at - q) : word( at - q) << b | word( at - q - 1) >> ( 64 - b);
+	}
+
+	size_t m_rows, m_cols, m_words;
+	std::array<uint16_t, 256> m_index;
+	std::vector<uint64_t> m_bits;
+};
+
+}
+
+#endif //PUZZLER_BITBOARD_HPP
@@ -0,0 +1,77 @@
+#ifndef PUZZLER_DIRECTION_LINES_HPP
+#define PUZZLER_DIRECTION_LINES_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * Every row, column and diagonal of a grid, copied once into one contiguous
+ * buffer. Lines run in the scan-order directions (E, S, SE and SW); reading a
+ * line backwards yields the opposite direction.
+ */
+class DirectionLines
+{
+public:
+	struct Line
+	{
+		Dir direction;
+		int x, y,       // First cell of the line.
+		    dx, dy;     // Offset from one cell to the next.
+		size_t offset, length;
+	};
+
+	template<typename Grid>
+	explicit DirectionLines( const Grid& grid)
+	{
+		auto rows = static_cast<int>( grid.size()),
+		     cols = rows == 0 ? 0 : static_cast<int>( grid[ 0].size());
+		m_buffer.reserve( 4 * static_cast<size_t>( rows) * static_cast<size_t>( cols));
+
+		for( int i = 0; i < rows; ++i)
+			extract( grid, rows, cols, { Dir::ET, i, 0, 0, 1, 0, 0});
+		for( int j = 0; j < cols; ++j)
+			extract( grid, rows, cols, { Dir::ST, 0, j, 1, 0, 0, 0});
+		for( int i = rows - 1; i > 0; --i)
+			extract( grid, rows, cols, { Dir::SE, i, 0, 1, 1, 0, 0});
+		for( int j = 0; j < cols; ++j)
+			extract( grid, rows, cols, { Dir::SE, 0, j, 1, 1, 0, 0});
+		for( int j = 0; j < cols; ++j)
+			extract( grid, rows, cols, { Dir::SW, 0, j, 1, -1, 0, 0});
+		for( int i = 1; i < rows; ++i)
+			extract( grid, rows, cols, { Dir::SW, i, cols - 1, 1, -1, 0, 0});
+	}
+
+	const std::vector<Line>& lines() const
+	{
+		return m_lines;
+	}
+
+	std::string_view text( const Line& line) const
+	{
+		return std::string_view( m_buffer).substr( line.offset, line.length);
+	}
+
+private:
+	template<typename Grid>
+	void extract( const Grid& grid, int rows, int cols, Line line)
+	{
+		line.offset = m_buffer.size();
+		for( int x = line.x, y = line.y; x >= 0 && x < rows && y >= 0 && y < cols; x += line.dx, y += line.dy)
+			m_buffer += grid[ static_cast<size_t>( x)][ static_cast<size_t>( y)];
+		line.length = m_buffer.size() - line.offset;
+		m_lines.push_back( line);
+	}
+
+	std::string m_buffer;
+	std::vector<Line> m_lines;
+};
+
+}
+
+#endif //PUZZLER_DIRECTION_LINES_HPP
@@ -0,0 +1,286 @@
+#ifndef PUZZLER_EVENT_LOOP_HPP
+#define PUZZLER_EVENT_LOOP_HPP
+
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#define STRINGIFY_IMPL( cmd) #cmd
+#define STRINGIFY( cmd) STRINGIFY_IMPL( cmd)
+#define Q( value) ( *(STRINGIFY( value)))
+
+#define KEY_QUIT     q
+#define KEY_PAUSE    p
+#define KEY_RESTART  r
+#define KEY_NEXT     n
+#define KEY_PREVIOUS b
+
+namespace detail
+{
+
+enum class  Event
+{
+	Resize,
+	Quit,
+	Pause,
+	Restart,
+	FocusIn,
+	FocusOut,
+	Next,
+	Previous,
+	Tick,       // The frame delay is over.
+	Interrupt,  // SIGINT
+	NoOp        // Any other key.
+};
+
+/*
+ * Single threaded source of every event the simulator reacts to: key presses
+ * on stdin, frame ticks from a timerfd and SIGWINCH/SIGINT from a signalfd,
+ * all waited on with one epoll descriptor. Ticks come from an absolute
+ * periodic timer, so keys pressed during a frame neither shorten nor
+ * lengthen it, and with the timer stopped nothing wakes the loop but input.
+ */
+class EventLoop
+{
+public:
+	/*
+	 * The loop of the process. Creating it blocks SIGWINCH and SIGINT in the
+	 * calling thread, which has to be the only one that does not block them
+	 * already, so both are queued for the signalfd instead of being handled
+	 * everywhere but inside an Interruptible.
+	 */
+	static EventLoop& instance()
+	{
+		static EventLoop loop;
+		return loop;
+	}
+
+	/*
+	 * Frame ticks for as long as it lives.
+	 */
+	class Ticks
+	{
+	public:
+		explicit Ticks( int ms)
+		{
+			instance().startTicks( ms);
+		}
+
+		Ticks( const Ticks&)            = delete;
+		Ticks& operator=( const Ticks&) = delete;
+
+		~Ticks()
+		{
+			instance().stopTicks();
+		}
+	};
+
+	/*
+	 * Lets SIGINT through to its handler for as long as it lives, so Ctrl-C
+	 * cuts short work on the loop's thread that keeps it from polling, like
+	 * solving a puzzle, instead of waiting for it to finish. One that came in
+	 * before is delivered as soon as this is created.
+	 */
+	class Interruptible
+	{
+	public:
+		Interruptible()
+		{
+			pthread_sigmask( SIG_UNBLOCK, &interrupt(), nullptr);
+		}
+
+		Interruptible( const Interruptible&)            = delete;
+		Interruptible& operator=( const Interruptible&) = delete;
+
+		~Interruptible()
+		{
+			pthread_sigmask( SIG_BLOCK, &interrupt(), nullptr);
+		}
+
+	private:
+		static const sigset_t& interrupt()
+		{
+			static const sigset_t signals = []
+			{
+				sigset_t set;
+				sigemptyset( &set);
+				sigaddset( &set, SIGINT);
+				return set;
+			}();
+			return signals;
+		}
+	};
+
+	EventLoop( const EventLoop&)            = delete;
+	EventLoop& operator=( const EventLoop&) = delete;
+
+	~EventLoop()
+	{
+		for( auto fd : { m_epoll, m_timer, m_signals})
+			if( fd >= 0)
+				close( fd);
+	}
+
+	/*
+	 * Tick every `ms` milliseconds from now on; 0 ticks whenever nothing else
+	 * is pending, for runs that should not be paced at all.
+	 */
+	void startTicks( int ms)
+	{
+		m_ticked  = false;
+		m_unpaced = ms <= 0;
+		struct itimerspec period{};
+		if( !m_unpaced)
+		{
+			period.it_interval.tv_sec  = ms / 1000;
+			period.it_interval.tv_nsec = ( ms % 1000) * 1000000L;
+			period.it_value            = period.it_interval;
+		}
+		timerfd_settime( m_timer, 0, &period, nullptr);
+	}
+
+	void stopTicks()
+	{
+		struct itimerspec disarmed{};
+		timerfd_settime( m_timer, 0, &disarmed, nullptr);
+		m_ticked = m_unpaced = false;
+	}
+
+	/*
+	 * Block until the next event. A signal comes before the keys read along
+	 * with it, and those before a tick that is due at the same time.
+	 */
+	Event next()
+	{
+		for( ;;)
+		{
+			if( m_interrupted)
+				return Event::Interrupt;
+			if( m_resized)
+			{
+				m_resized = false;
+				return Event::Resize;
+			}
+			if( !m_input.empty())
+				return takeKey();
+			if( m_ticked)
+			{
+				m_ticked = false;
+				return Event::Tick;
+			}
+			if( m_unpaced && !wait( 0))
+				return Event::Tick;
+			if( !m_unpaced)
+				wait( -1);
+		}
+	}
+
+private:
+	EventLoop()
+	{
+		sigset_t signals;
+		sigemptyset( &signals);
+		sigaddset( &signals, SIGWINCH);
+		sigaddset( &signals, SIGINT);
+		pthread_sigmask( SIG_BLOCK, &signals, nullptr);
+
+		m_epoll   = epoll_create1( EPOLL_CLOEXEC);
+		m_timer   = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		m_signals = signalfd( -1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+		if( m_epoll < 0 || m_timer < 0 || m_signals < 0 || !watch( m_timer) || !watch( m_signals))
+		{
+			fprintf( stderr, "Unable to set up the event loop: %s\n", strerror( errno));
+			exit( EXIT_FAILURE);
+		}
+		// Regular files and /dev/null cannot be watched; they never have a key to give.
+		watch( STDIN_FILENO);
+	}
+
+	bool watch( int fd)
+	{
+		struct epoll_event event{};
+		event.events  = EPOLLIN;
+		event.data.fd = fd;
+		return epoll_ctl( m_epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+	}
+
+	/*
+	 * Collect whatever is ready within `timeout` milliseconds (-1 waits for
+	 * good); false if nothing was.
+	 */
+	bool wait( int timeout)
+	{
+		struct epoll_event ready[ 3];
+		auto n_ready = epoll_wait( m_epoll, ready, 3, timeout);
+		for( int i = 0; i < n_ready; ++i)
+		{
+			auto fd = ready[ i].data.fd;
+			if( fd == m_timer)
+			{
+				// Ticks missed while busy are dropped rather than bunched up.
+				uint64_t expirations;
+				if( read( m_timer, &expirations, sizeof expirations) == sizeof expirations)
+					m_ticked = true;
+			}
+			else if( fd == m_signals)
+			{
+				struct signalfd_siginfo info;
+				while( read( m_signals, &info, sizeof info) == sizeof info)
+					( info.ssi_signo == SIGINT ? m_interrupted : m_resized) = true;
+			}
+			else
+			{
+				char buffer[ 64];
+				auto size = read( STDIN_FILENO, buffer, sizeof buffer);
+				if( size > 0)
+					m_input.insert( m_input.end(), buffer, buffer + size);
+				else if( size == 0 || ( errno != EINTR && errno != EAGAIN))
+					// End of input: stop listening instead of waking up for it forever.
+					epoll_ctl( m_epoll, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);
+			}
+		}
+		return n_ready > 0;
+	}
+
+	Event takeKey()
+	{
+		auto input = m_input.front();
+		m_input.pop_front();
+		if( input == Q( KEY_QUIT))
+			return Event::Quit;
+		else if( input == Q( KEY_PAUSE))
+			return Event::Pause;
+		else if( input == Q( KEY_RESTART))
+			return Event::Restart;
+		else if( input == Q( KEY_NEXT))
+			return Event::Next;
+		else if( input == Q( KEY_PREVIOUS))
+			return Event::Previous;
+		else if( input == '\x1B' && m_input.size() >= 2 && m_input[ 0] == '[' && ( m_input[ 1] == 'I' || m_input[ 1] == 'O'))
+		{
+			// Focus reports: ESC [ I when the terminal gains focus, ESC [ O when it loses it.
+			auto gained = m_input[ 1] == 'I';
+			m_input.erase( m_input.begin(), m_input.begin() + 2);
+			return gained ? Event::FocusIn : Event::FocusOut;
+		}
+
+		return Event::NoOp;
+	}
+
+	int m_epoll{ -1}, m_timer{ -1}, m_signals{ -1};
+	std::deque<char> m_input;
+	bool m_ticked{}, m_unpaced{}, m_resized{}, m_interrupted{};
+};
+
+}
+
+#endif //PUZZLER_EVENT_LOOP_HPP
@@ -0,0 +1,88 @@
+#ifndef PUZZLER_MAPPED_FILE_HPP
+#define PUZZLER_MAPPED_FILE_HPP
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+namespace detail
+{
+
+/*
+ * Read-only mapping of a whole file. Shared between every object that keeps
+ * views into it, the mapping goes away with the last reference.
+ */
+class MappedFile
+{
+public:
+	static std::shared_ptr<const MappedFile> open( const char *path)
+	{
+		int fd = ::open( path, O_RDONLY | O_CLOEXEC);
+		if( fd < 0)
+			return nullptr;
+
+		struct stat info{};
+		if( fstat( fd, &info) != 0 || !S_ISREG( info.st_mode))
+		{
+			::close( fd);
+			return nullptr;
+		}
+
+		auto size = static_cast<size_t>( info.st_size);
+		void *address = nullptr;
+		if( size > 0)
+		{
+			address = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if( address == MAP_FAILED)
+			{
+				::close( fd);
+				return nullptr;
+			}
+			madvise( address, size, MADV_SEQUENTIAL);
+		}
+		::close( fd);    // The mapping outlives the descriptor.
+
+		return std::shared_ptr<const MappedFile>( new MappedFile( static_cast<const char *>( address), size));
+	}
+
+	MappedFile( const MappedFile&)            = delete;
+	MappedFile& operator=( const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		if( m_data != nullptr)
+			munmap( const_cast<char *>( m_data), m_size);
+	}
+
+	const char *data() const
+	{
+		return m_data;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	std::string_view view() const
+	{
+		return { m_data, m_size};
+	}
+
+private:
+	MappedFile( const char *data, size_t size)
+		: m_data( data), m_size( size)
+	{
+	}
+
+	const char *m_data;
+	size_t m_size;
+};
+
+}
+
+#endif //PUZZLER_MAPPED_FILE_HPP
@@ -42,11 +42,13 @@ public:
 
 			auto equal_to_position = std::find( current_option.rbegin(), current_option.rend(), '=').base();
             std::string key, value;
-			if( equal_to_position != current_option.cend())
+			if( equal_to_position != current_option.cbegin())
 			{
 				key  = std::string( current_option.begin(), std::prev( equal_to_position));
 				value = std::string( equal_to_position, current_option.end());
 			}
+			else
+				key = std::string( current_option);
 			auto matching = options.find( key);
 			if( matching != options.cend())
 			{
@@ -56,8 +58,14 @@ public:
 					while( count-- && i < argc)
 						matched_options[ key].emplace_back( argv[ i++]);
 				}
+				else if( !value.empty())
+					matched_options[ key].emplace_back( value);
 				else
-					matched_options[ key].emplace_back( value.empty() ? key : value);
+				{
+					// A bare flag reads as its long name, whichever way it was spelled.
+					auto is_long = std::find( long_options.cbegin(), long_options.cend(), key) != long_options.cend();
+					matched_options[ key].emplace_back( is_long ? key : std::string( option_pair.at( key)));
+				}
 			}
 			else
 				mis_handler( current_option);
@@ -0,0 +1,207 @@
+#ifndef PUZZLER_PACKED_LINES_HPP
+#define PUZZLER_PACKED_LINES_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "puzzle-grid.hpp"
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * Key packed the way PackedLines holds the grid: twelve 5 bit letter codes
+ * to a word, both as written and reversed.
+ */
+struct PackedKey
+{
+	std::vector<uint64_t> forward, backward;
+	size_t size{};
+};
+
+/*
+ * Every row, column and diagonal of a grid, in the scan-order directions
+ * (E, S, SE and SW), as 5 bit letter codes packed twelve to a 64 bit word.
+ * Verifying a key then takes one masked compare per twelve of its letters,
+ * on words that lie next to each other whichever way the key runs, instead
+ * of a byte compare per letter a row apart. Only A-Z have codes; any other
+ * cell is 0, which no key letter is.
+ */
+class PackedLines
+{
+public:
+	static constexpr size_t LETTERS = 12;
+	static constexpr uint64_t ALL   = ( uint64_t{ 1} << 5 * LETTERS) - 1;
+
+	explicit PackedLines( const PuzzleGrid& grid)
+		: m_rows( static_cast<int>( grid.rows())), m_cols( static_cast<int>( grid.cols()))
+	{
+		// Lay the lines out first; SE diagonals are numbered by j - i, SW ones by i + j.
+		size_t words = 0;
+		auto lay = [ &]( Family family, int lines, auto length)
+		{
+			for( int line = 0; line < lines; ++line)
+			{
+				m_lines[ family].push_back( words);
+				words += ( static_cast<size_t>( length( line)) + LETTERS - 1) / LETTERS;
+			}
+		};
+		auto diagonals = std::max( 0, m_rows + m_cols - 1);
+		lay( EAST, m_rows, [ this]( int) { return m_cols; });
+		lay( SOUTH, m_cols, [ this]( int) { return m_rows; });
+		auto diagonal = [ &]( int d) { return std::min( { m_rows, m_cols, d + 1, diagonals - d}); };
+		lay( SOUTH_EAST, diagonals, diagonal);
+		lay( SOUTH_WEST, diagonals, diagonal);
+		// A word to spare past the last line, so any load can take the word after.
+		m_words.assign( words + 1, 0);
+
+		// Then fill them in one pass over the grid, in the order it lies in memory.
+		for( int i = 0; i < m_rows; ++i)
+		{
+			auto row = grid.row( static_cast<size_t>( i));
+			for( int j = 0; j < m_cols; ++j)
+			{
+				auto letter = CODES[ static_cast<uint8_t>( row[ static_cast<size_t>( j)])];
+				auto put    = [ &]( Family family, int line, int pos)
+				{
+					auto p = static_cast<size_t>( pos);
+					m_words[ m_lines[ family][ static_cast<size_t>( line)] + p / LETTERS] |= letter << 5 * ( p % LETTERS);
+				};
+				put( EAST, i, j);
+				put( SOUTH, j, i);
+				put( SOUTH_EAST, j - i + m_rows - 1, std::min( i, j));
+				put( SOUTH_WEST, i + j, std::min( i, m_cols - 1 - j));
+			}
+		}
+	}
+
+	/*
+	 * `key` in packed form; nullopt if it holds anything but A-Z.
+	 */
+	static std::optional<PackedKey> pack( std::string_view key)
+	{
+		PackedKey packed;
+		packed.size = key.size();
+		packed.forward.assign(( key.size() + LETTERS - 1) / LETTERS, 0);
+		packed.backward.assign( packed.forward.size(), 0);
+		for( size_t k = 0; k < key.size(); ++k)
+		{
+			auto letter = code( key[ k]);
+			if( letter == 0)
+				return std::nullopt;
+			packed.forward[ k / LETTERS] |= letter << 5 * ( k % LETTERS);
+			auto r = key.size() - 1 - k;
+			packed.backward[ r / LETTERS] |= letter << 5 * ( r % LETTERS);
+		}
+		return packed;
+	}
+
+	/*
+	 * Whether `key` reads from ( row, col) along `direction`.
+	 */
+	bool spells( const PackedKey& key, int row, int col, Dir direction) const
+	{
+		auto n = key.size;
+		if( n == 0)
+			return true;
+		// Against scan order the key reads as its reversal, ending at ( row, col).
+		auto forward = direction == Dir::ET || direction == Dir::ST || direction == Dir::SE || direction == Dir::SW;
+		auto [ line, pos, length] = locate( forward ? direction : opposite( direction), row, col);
+		if( forward ? pos + n > length : pos + 1 < n)
+			return false;
+
+		const auto& chunks = forward ? key.forward : key.backward;
+		auto first = forward ? pos : pos + 1 - n;
+		for( size_t c = 0; c < chunks.size(); ++c)
+		{
+			auto rest = n - c * LETTERS;
+			auto mask = rest >= LETTERS ? ALL : ( uint64_t{ 1} << 5 * rest) - 1;
+			if( ( load( line, first + c * LETTERS) ^ chunks[ c]) & mask)
+				return false;
+		}
+		return true;
+	}
+
+private:
+	enum Family
+	{
+		EAST,
+		SOUTH,
+		SOUTH_EAST,
+		SOUTH_WEST,
+		FAMILIES
+	};
+
+	struct Location
+	{
+		size_t line, pos, length;
+	};
+
+	static constexpr std::array<uint64_t, 256> CODES = []
+	{
+		std::array<uint64_t, 256> codes{};
+		for( int c = 'A'; c <= 'Z'; ++c)
+			codes[ static_cast<size_t>( c)] = static_cast<uint64_t>( c - 'A' + 1);
+		return codes;
+	}();
+
+	static uint64_t code( char c)
+	{
+		return CODES[ static_cast<uint8_t>( c)];
+	}
+
+	/*
+	 * The line through ( row, col) in scan-order `direction`, the cell's
+	 * place along it and the line's length.
+	 */
+	Location locate( Dir direction, int row, int col) const
+	{
+		auto at = [ this]( Family family, int line) { return m_lines[ family][ static_cast<size_t>( line)]; };
+		switch( direction)
+		{
+			case Dir::ET:
+				return { at( EAST, row), static_cast<size_t>( col), static_cast<size_t>( m_cols)};
+			case Dir::ST:
+				return { at( SOUTH, col), static_cast<size_t>( row), static_cast<size_t>( m_rows)};
+			case Dir::SE:
+			{
+				auto top = std::max( 0, row - col), left = std::max( 0, col - row);
+				return { at( SOUTH_EAST, col - row + m_rows - 1), static_cast<size_t>( row - top),
+				         static_cast<size_t>( std::min( m_rows - top, m_cols - left))};
+			}
+			default:
+			{
+				auto top = std::max( 0, row + col - ( m_cols - 1)), right = row + col - top;
+				return { at( SOUTH_WEST, row + col), static_cast<size_t>( row - top),
+				         static_cast<size_t>( std::min( m_rows - top, right + 1))};
+			}
+		}
+	}
+
+	/*
+	 * The codes of the twelve cells from `pos` on along the line that starts
+	 * at word `line`.
+	 */
+	uint64_t load( size_t line, size_t pos) const
+	{
+		auto word  = m_words.data() + line + pos / LETTERS;
+		auto shift = 5 * ( pos % LETTERS);
+		auto bits  = word[ 0] >> shift;
+		if( shift > 0)
+			bits |= word[ 1] << ( 5 * LETTERS - shift);
+		return bits & ALL;
+	}
+
+	int m_rows, m_cols;
+	std::array<std::vector<size_t>, FAMILIES> m_lines;    // First word of every line of each family.
+	std::vector<uint64_t> m_words;
+};
+
+}
+
+#endif //PUZZLER_PACKED_LINES_HPP
@@ -0,0 +1,237 @@
+#ifndef PUZZLER_PUZZLE_ARCHIVE_HPP
+#define PUZZLER_PUZZLE_ARCHIVE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped-file.hpp"
+#include "puzzle-grid.hpp"
+#include "puzzle-reader.hpp"
+#include "solution-cache.hpp"
+
+namespace detail
+{
+
+/*
+ * Puzzle file compiled into a form that is mapped and used as is, so opening
+ * one costs the same whatever its size and any puzzle is reached in constant
+ * time. In native byte order the file holds:
+ *
+ *   Header
+ *   for every puzzle, each part starting on a 64 byte boundary:
+ *     char      grid[ rows * stride]        rows padded with blanks up to the stride
+ *     uint32_t  key_offsets[ keys + 1]      where each key starts in the key text
+ *     char      key_text[]                  the keys, back to back
+ *     uint32_t  letters[ letters]           code points of the ids past ASCII, 4 byte aligned
+ *     Match     solution[ matches]          only when compiled with an engine
+ *   Entry     directory[ puzzles]
+ */
+class PuzzleArchive
+{
+public:
+	using Match = SolutionCache::Match;
+
+	/*
+	 * View `file` as an archive; nullptr if it is not one of this version.
+	 */
+	static std::shared_ptr<const PuzzleArchive> open( std::shared_ptr<const MappedFile> file)
+	{
+		if( !file || file->size() < sizeof( Header) || std::memcmp( file->data(), MAGIC, sizeof( Header::magic)) != 0)
+			return nullptr;
+
+		Header header;
+		std::memcpy( &header, file->data(), sizeof header);
+		if( header.version == 0 || header.version > VERSION || header.size != file->size() || header.directory % alignof( Entry) != 0
+		    || header.directory > header.size || ( header.size - header.directory) / sizeof( Entry) < header.puzzles)
+			return nullptr;
+		return std::shared_ptr<const PuzzleArchive>( new PuzzleArchive( std::move( file), header));
+	}
+
+	/*
+	 * Write every puzzle `reader` has left to `path`. With a `solve`
+	 * function, each puzzle is stored along with the matches it returns,
+	 * which are those of the engine numbered `engine`. The file is renamed
+	 * into place once complete, so a concurrent reader never maps half of it.
+	 */
+	static bool compile( PuzzleFileReader& reader, const std::string& path, int engine = -1,
+	                     const std::function<std::vector<Match>( const PuzzleImage&)>& solve = {})
+	{
+		auto partial = path + ".partial";
+		std::ofstream out( partial, std::ios::binary | std::ios::trunc);
+		if( !out)
+			return false;
+
+		uint64_t offset = 0;
+		auto put = [ &]( const void *data, size_t size)
+		{
+			out.write( static_cast<const char *>( data), static_cast<std::streamsize>( size));
+			offset += size;
+		};
+		auto align = [ &]( uint64_t alignment)
+		{
+			static constexpr char ZEROS[ 64] = {};
+			put( ZEROS, static_cast<size_t>( ( alignment - offset % alignment) % alignment));
+		};
+
+		Header header{};
+		std::memcpy( header.magic, MAGIC, sizeof header.magic);
+		header.version = VERSION;
+		header.engine  = solve ? engine : -1;
+		put( &header, sizeof header);
+
+		std::vector<Entry> directory;
+		std::string row;
+		while( auto image = reader.next())
+		{
+			Entry entry{};
+			auto& grid   = image->puzzle;
+			entry.rows   = static_cast<uint32_t>( grid.rows());
+			entry.cols   = static_cast<uint32_t>( grid.cols());
+			// Rows start 16 byte aligned, like vector loads want them.
+			entry.stride = ( entry.cols + 15) / 16 * 16;
+			align( 64);
+			entry.grid = offset;
+			for( size_t i = 0; i < grid.rows(); ++i)
+			{
+				row.assign( grid.row( i));
+				row.resize( entry.stride, ' ');
+				put( row.data(), row.size());
+			}
+
+			align( 64);
+			entry.keys   = offset;
+			entry.n_keys = static_cast<uint32_t>( image->keys.size());
+			std::vector<uint32_t> key_offsets{ 0};
+			for( auto key : image->keys)
+				key_offsets.push_back( key_offsets.back() + static_cast<uint32_t>( key.size()));
+			put( key_offsets.data(), key_offsets.size() * sizeof( uint32_t));
+			for( auto key : image->keys)
+				put( key.data(), key.size());
+			if( auto alphabet = grid.alphabet())
+			{
+				align( alignof( uint32_t));
+				std::vector<uint32_t> letters( alphabet->letters().cbegin(), alphabet->letters().cend());
+				entry.letters = static_cast<uint32_t>( letters.size());
+				put( letters.data(), letters.size() * sizeof( uint32_t));
+			}
+
+			if( solve)
+			{
+				auto matches = solve( *image);
+				align( 64);
+				entry.solution  = offset;
+				entry.n_matches = static_cast<uint32_t>( matches.size());
+				put( matches.data(), matches.size() * sizeof( Match));
+			}
+			directory.push_back( entry);
+		}
+
+		align( 64);
+		header.directory = offset;
+		header.puzzles   = directory.size();
+		put( directory.data(), directory.size() * sizeof( Entry));
+		header.size = offset;
+		out.seekp( 0);
+		out.write( reinterpret_cast<const char *>( &header), sizeof header);
+		if( !out.flush())
+		{
+			out.close();
+			std::remove( partial.c_str());
+			return false;
+		}
+		out.close();
+		return std::rename( partial.c_str(), path.c_str()) == 0;
+	}
+
+	size_t size() const
+	{
+		return m_header.puzzles;
+	}
+
+	/*
+	 * Puzzle `index`, viewing the archive; nullopt past the last puzzle or if
+	 * its entry does not fit in the file.
+	 */
+	std::optional<PuzzleImage> get( size_t index) const
+	{
+		if( index >= size())
+			return std::nullopt;
+
+		Entry entry;
+		std::memcpy( &entry, m_file->data() + m_header.directory + index * sizeof( Entry), sizeof entry);
+		auto fits = [ this]( uint64_t offset, uint64_t size)
+		{
+			return offset <= m_header.directory && size <= m_header.directory - offset;
+		};
+		if( entry.stride < entry.cols || !fits( entry.grid, uint64_t{ entry.rows} * entry.stride)
+		    || entry.keys % alignof( uint32_t) != 0 || !fits( entry.keys, ( uint64_t{ entry.n_keys} + 1) * sizeof( uint32_t))
+		    || entry.solution % alignof( Match) != 0 || !fits( entry.solution, uint64_t{ entry.n_matches} * sizeof( Match)))
+			return std::nullopt;
+
+		auto key_offsets = reinterpret_cast<const uint32_t *>( m_file->data() + entry.keys);
+		auto key_text    = reinterpret_cast<const char *>( key_offsets + entry.n_keys + 1);
+		auto text_begin  = entry.keys + ( uint64_t{ entry.n_keys} + 1) * sizeof( uint32_t);
+		auto letters     = ( text_begin + key_offsets[ entry.n_keys] + alignof( uint32_t) - 1) / alignof( uint32_t) * alignof( uint32_t);
+		if( !fits( text_begin, key_offsets[ entry.n_keys]) || !fits( letters, uint64_t{ entry.letters} * sizeof( uint32_t)))
+			return std::nullopt;
+
+		PuzzleImage image;
+		image.puzzle = PuzzleGrid( m_file, m_file->data() + entry.grid, entry.rows, entry.cols, entry.stride);
+		if( entry.letters > 0)
+		{
+			auto first = reinterpret_cast<const uint32_t *>( m_file->data() + letters);
+			image.puzzle = image.puzzle.spelledWith(
+				std::make_shared<const Alphabet>( std::vector<char32_t>( first, first + entry.letters)));
+		}
+		image.keys.reserve( entry.n_keys);
+		for( uint32_t k = 0; k < entry.n_keys; ++k)
+		{
+			if( key_offsets[ k] > key_offsets[ k + 1])
+				return std::nullopt;
+			image.keys.emplace_back( key_text + key_offsets[ k], key_offsets[ k + 1] - key_offsets[ k]);
+		}
+		if( m_header.engine >= 0)
+			image.solution = { m_header.engine, reinterpret_cast<const Match *>( m_file->data() + entry.solution), entry.n_matches};
+		return image;
+	}
+
+private:
+	static constexpr char MAGIC[ 8]  = { 'P', 'Z', 'A', 'R', 'C', 'H', '\0', '\0'};
+	// Version 1 archives hold no letters past ASCII and read as they are.
+	static constexpr uint32_t VERSION = 2;
+
+	struct Header
+	{
+		char magic[ 8];
+		uint32_t version;
+		int32_t engine;         // Engine the stored solutions come from, -1 without any.
+		uint64_t puzzles, directory, size;
+	};
+
+	struct Entry
+	{
+		uint64_t grid, keys, solution;
+		uint32_t rows, cols, stride, n_keys, n_matches, letters;
+	};
+
+	static_assert( sizeof( Match) == 16, "matches are stored as they are laid out in memory");
+
+	PuzzleArchive( std::shared_ptr<const MappedFile> file, const Header& header)
+		: m_file( std::move( file)), m_header( header)
+	{
+	}
+
+	std::shared_ptr<const MappedFile> m_file;
+	Header m_header;
+};
+
+}
+
+#endif //PUZZLER_PUZZLE_ARCHIVE_HPP
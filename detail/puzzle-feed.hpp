@@ -0,0 +1,182 @@
+#ifndef PUZZLER_PUZZLE_FEED_HPP
+#define PUZZLER_PUZZLE_FEED_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "puzzle-archive.hpp"
+#include "puzzle-reader.hpp"
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * Parses a puzzle file on a background thread and hands puzzles out as soon
+ * as each one is complete, so the first puzzle can be solved and shown while
+ * the rest of the file is still being read. The parser stays at most
+ * LOOKAHEAD puzzles ahead of the furthest one asked for. Puzzles are kept
+ * once parsed, so the simulator can go back to any of them: returned
+ * pointers stay valid until a forward-only consumer releases them, or for
+ * the lifetime of the feed. A compiled archive needs no parsing: its puzzles
+ * are looked up as they are asked for.
+ */
+class PuzzleFeed
+{
+public:
+	static constexpr size_t LOOKAHEAD = 64;
+
+	explicit PuzzleFeed( PuzzleFileReader& reader)
+		: m_reader( &reader)
+	{
+		m_parser = std::thread( [ this] { parse(); });
+	}
+
+	explicit PuzzleFeed( std::shared_ptr<const PuzzleArchive> archive)
+		: m_archive( std::move( archive)), m_done( true)
+	{
+	}
+
+	PuzzleFeed( const PuzzleFeed&)            = delete;
+	PuzzleFeed& operator=( const PuzzleFeed&) = delete;
+
+	~PuzzleFeed()
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_mutex);
+			m_stopping = true;
+		}
+		m_wanted_more.notify_all();
+		if( m_parser.joinable())
+			m_parser.join();
+	}
+
+	/*
+	 * Wait until puzzle `index` has been parsed; null if the file has fewer
+	 * puzzles or it has been released.
+	 */
+	const PuzzleImage *get( size_t index)
+	{
+		std::unique_lock<std::mutex> lock( m_mutex);
+		if( index < m_released)
+			return nullptr;
+		if( m_archive)
+		{
+			auto opened = m_opened.find( index);
+			if( opened == m_opened.end())
+			{
+				auto image = m_archive->get( index);
+				if( !image)
+					return nullptr;
+				opened = m_opened.emplace( index, std::move( *image)).first;
+			}
+			return &opened->second;
+		}
+		want( index + 1);
+		m_arrived.wait( lock, [ &] { return index < parsed() || m_done; });
+		return index < parsed() ? &m_puzzles[ index - m_released] : nullptr;
+	}
+
+	/*
+	 * Drop every puzzle before `index`, which a consumer going through the
+	 * puzzles once calls as it is done with them. Pointers to them dangle
+	 * from then on and get() no longer hands them out.
+	 */
+	void release( size_t index)
+	{
+		std::lock_guard<std::mutex> lock( m_mutex);
+		// Text puzzles not parsed yet cannot be let go of.
+		for( ; m_released < index && ( m_archive || !m_puzzles.empty()); ++m_released)
+		{
+			if( m_archive)
+				m_opened.erase( m_released);
+			else
+				m_puzzles.pop_front();
+		}
+	}
+
+	/*
+	 * Total number of puzzles, which waits for the whole file to be parsed.
+	 */
+	size_t size()
+	{
+		if( m_archive)
+			return m_archive->size();
+		std::unique_lock<std::mutex> lock( m_mutex);
+		want( SIZE_MAX - LOOKAHEAD);
+		m_arrived.wait( lock, [ this] { return m_done; });
+		return parsed();
+	}
+
+	/*
+	 * Number of puzzles parsed so far, without waiting.
+	 */
+	size_t available()
+	{
+		if( m_archive)
+			return m_archive->size();
+		std::lock_guard<std::mutex> lock( m_mutex);
+		return parsed();
+	}
+
+private:
+	size_t parsed() const
+	{
+		return m_released + m_puzzles.size();
+	}
+
+	// Let the parser run LOOKAHEAD puzzles past the first `count`; called with m_mutex held.
+	void want( size_t count)
+	{
+		if( count <= m_wanted)
+			return;
+		m_wanted = count;
+		m_wanted_more.notify_one();
+	}
+
+	void parse()
+	{
+		util::blockSignals();
+		for( ;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock( m_mutex);
+				m_wanted_more.wait( lock, [ this] { return m_stopping || parsed() < m_wanted + LOOKAHEAD; });
+				if( m_stopping)
+					break;
+			}
+			auto image = m_reader->next();
+			std::lock_guard<std::mutex> lock( m_mutex);
+			if( image)
+				m_puzzles.push_back( std::move( *image));
+			else
+				m_done = true;
+			m_arrived.notify_all();
+			if( m_done)
+				return;
+		}
+
+		std::lock_guard<std::mutex> lock( m_mutex);
+		m_done = true;
+		m_arrived.notify_all();
+	}
+
+	PuzzleFileReader *m_reader{};
+	std::shared_ptr<const PuzzleArchive> m_archive;
+	std::deque<PuzzleImage> m_puzzles;                   // From puzzle m_released on.
+	std::unordered_map<size_t, PuzzleImage> m_opened;    // Archive puzzles asked for so far.
+	std::mutex m_mutex;
+	std::condition_variable m_arrived, m_wanted_more;
+	size_t m_wanted{}, m_released{};
+	bool m_stopping{ false};
+	bool m_done{ false};
+	std::thread m_parser;
+};
+
+}
+
+#endif //PUZZLER_PUZZLE_FEED_HPP
@@ -0,0 +1,219 @@
+#ifndef PUZZLER_PUZZLE_GENERATOR_HPP
+#define PUZZLER_PUZZLE_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * What PuzzleGenerator produces. Directions name the way a key is written
+ * into the grid; a reversed key is written back to front along it.
+ */
+struct GeneratorSpec
+{
+	uint64_t seed{ 1};
+	size_t puzzles{ 1};
+	size_t rows{ 20}, cols{ 20};
+	size_t keys{ 20};
+	size_t min_length{ 3}, max_length{ 10};   // Key lengths are uniform over this range.
+	std::vector<Dir> directions{ Dir::ET, Dir::ST, Dir::SE, Dir::SW};
+	double reversed{ 0.5};                    // Share of keys written back to front.
+	double decoys{ 0.0};                      // Near misses planted per key.
+};
+
+/*
+ * Writes reproducible puzzle files for scaling tests. The random numbers
+ * come from a SplitMix64 stream reduced without the standard distributions,
+ * whose output differs between standard libraries, so a seed names the same
+ * file everywhere.
+ */
+class PuzzleGenerator
+{
+public:
+	struct Puzzle
+	{
+		std::vector<std::string> rows;
+		std::vector<std::string> keys;
+	};
+
+	explicit PuzzleGenerator( GeneratorSpec spec)
+		: m_spec( std::move( spec)), m_state( m_spec.seed)
+	{
+	}
+
+	/*
+	 * Grid and keys of the next puzzle. Keys that cannot be fitted after a
+	 * few attempts are dropped, so crowded grids may list fewer keys.
+	 */
+	Puzzle next()
+	{
+		Puzzle puzzle;
+		m_cells.assign( m_spec.rows * m_spec.cols, EMPTY);
+		std::unordered_set<std::string> seen;
+		for( size_t k = 0; k < m_spec.keys; ++k)
+		{
+			auto key = randomWord( m_spec.min_length + below( m_spec.max_length - m_spec.min_length + 1));
+			if( !seen.insert( key).second)
+				continue;
+
+			auto reversed = unit() < m_spec.reversed;
+			if( !place( reversed ? util::reversed( key) : key))
+				continue;
+			puzzle.keys.push_back( key);
+
+			// A decoy spells all but the last letter of the key, then goes astray.
+			auto whole    = static_cast<size_t>( m_spec.decoys);
+			auto n_decoys = whole + ( unit() < m_spec.decoys - static_cast<double>( whole) ? 1 : 0);
+			for( size_t i = 0; i < n_decoys && key.size() > 1; ++i)
+			{
+				auto decoy = key;
+				decoy.back() = static_cast<char>( 'A' + ( decoy.back() - 'A' + 1 + static_cast<int>( below( 25))) % 26);
+				place( reversed ? util::reversed( decoy) : decoy);
+			}
+		}
+
+		for( auto& cell : m_cells)
+			if( cell == EMPTY)
+				cell = static_cast<char>( 'A' + below( 26));
+		puzzle.rows.reserve( m_spec.rows);
+		for( size_t i = 0; i < m_spec.rows; ++i)
+			puzzle.rows.emplace_back( m_cells, i * m_spec.cols, m_spec.cols);
+		return puzzle;
+	}
+
+	/*
+	 * Every puzzle of the spec in the `Puzzle:`/`Key:` format, followed by the
+	 * header that closes the last one.
+	 */
+	void write( std::ostream& strm)
+	{
+		for( size_t n = 0; n < m_spec.puzzles; ++n)
+		{
+			auto puzzle = next();
+			strm << "Puzzle:\n";
+			for( auto& row : puzzle.rows)
+				strm << row << '\n';
+			strm << "Key:\n";
+			for( auto& key : puzzle.keys)
+				strm << key << '\n';
+		}
+		strm << "end:\n";
+	}
+
+	/*
+	 * Comma separated direction names as printed by dirName(), or `all`.
+	 */
+	static std::optional<std::vector<Dir>> parseDirections( std::string_view names)
+	{
+		if( names == "all")
+			return std::vector<Dir>{ Dir::NT, Dir::ST, Dir::WT, Dir::ET, Dir::NE, Dir::SW, Dir::NW, Dir::SE};
+
+		std::vector<Dir> directions;
+		while( !names.empty())
+		{
+			auto comma = names.find( ',');
+			auto name  = names.substr( 0, comma);
+			names.remove_prefix( comma == std::string_view::npos ? names.size() : comma + 1);
+
+			std::optional<Dir> match;
+			for( auto d : { Dir::NT, Dir::ST, Dir::WT, Dir::ET, Dir::NE, Dir::SW, Dir::NW, Dir::SE})
+				if( name == dirName( d))
+					match = d;
+			if( !match)
+				return std::nullopt;
+			directions.push_back( *match);
+		}
+		if( directions.empty())
+			return std::nullopt;
+		return directions;
+	}
+
+private:
+	static constexpr char EMPTY = '\0';
+
+	uint64_t random()
+	{
+		auto z = ( m_state += 0x9E3779B97F4A7C15ULL);
+		z = ( z ^ ( z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = ( z ^ ( z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ ( z >> 31);
+	}
+
+	// Uniform in [0, n), rejecting the values that would favour small results.
+	size_t below( size_t n)
+	{
+		auto bound = static_cast<uint64_t>( n);
+		auto floor = ( 0 - bound) % bound;
+		uint64_t r;
+		do
+			r = random();
+		while( r < floor);
+		return static_cast<size_t>( r % bound);
+	}
+
+	double unit()
+	{
+		return static_cast<double>( random() >> 11) * ( 1.0 / 9007199254740992.0);
+	}
+
+	std::string randomWord( size_t length)
+	{
+		std::string word( length, ' ');
+		for( auto& c : word)
+			c = static_cast<char>( 'A' + below( 26));
+		return word;
+	}
+
+	/*
+	 * Write `word` along a random allowed direction from a random cell, sharing
+	 * only cells that already hold the same letter.
+	 */
+	bool place( const std::string& word)
+	{
+		auto rows = static_cast<long>( m_spec.rows), cols = static_cast<long>( m_spec.cols),
+		     span = static_cast<long>( word.size()) - 1;
+		for( int attempt = 0; attempt < 32; ++attempt)
+		{
+			auto d  = static_cast<int>( m_spec.directions[ below( m_spec.directions.size())]);
+			auto dx = DIR_DX[ d], dy = DIR_DY[ d];
+			// Pick the start among the cells that keep the whole word on the grid.
+			auto x_lo = dx < 0 ? span : 0, x_hi = dx > 0 ? rows - 1 - span : rows - 1,
+			     y_lo = dy < 0 ? span : 0, y_hi = dy > 0 ? cols - 1 - span : cols - 1;
+			if( x_lo > x_hi || y_lo > y_hi)
+				continue;
+			auto x = x_lo + static_cast<long>( below( static_cast<size_t>( x_hi - x_lo + 1))),
+			     y = y_lo + static_cast<long>( below( static_cast<size_t>( y_hi - y_lo + 1)));
+
+			bool fits = true;
+			for( long i = 0; fits && i <= span; ++i)
+			{
+				auto cell = m_cells[ static_cast<size_t>(( x + i * dx) * cols + y + i * dy)];
+				fits = cell == EMPTY || cell == word[ static_cast<size_t>( i)];
+			}
+			if( !fits)
+				continue;
+
+			for( long i = 0; i <= span; ++i)
+				m_cells[ static_cast<size_t>(( x + i * dx) * cols + y + i * dy)] = word[ static_cast<size_t>( i)];
+			return true;
+		}
+		return false;
+	}
+
+	GeneratorSpec m_spec;
+	uint64_t m_state;
+	std::string m_cells;
+};
+
+}
+
+#endif //PUZZLER_PUZZLE_GENERATOR_HPP
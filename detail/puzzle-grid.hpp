@@ -0,0 +1,142 @@
+#ifndef PUZZLER_PUZZLE_GRID_HPP
+#define PUZZLER_PUZZLE_GRID_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "alphabet.hpp"
+
+namespace detail
+{
+
+/*
+ * Immutable row-major grid of letters. Copies share one reference counted
+ * buffer, so the reader, the solver and the simulator all look at the same
+ * memory. Ragged rows are padded with blanks up to the widest row. Every
+ * cell is one byte, which past ASCII is an id of the grid's alphabet.
+ */
+class PuzzleGrid
+{
+public:
+	PuzzleGrid() = default;
+
+	explicit PuzzleGrid( const std::vector<std::string>& rows)
+		: m_rows( rows.size())
+	{
+		for( auto& row : rows)
+			m_cols = std::max( m_cols, row.size());
+		m_stride = m_cols;
+
+		auto buffer = std::make_shared<std::string>( m_rows * m_stride, ' ');
+		for( size_t i = 0; i < m_rows; ++i)
+			std::copy( rows[ i].cbegin(), rows[ i].cend(), buffer->begin() + static_cast<long>( i * m_stride));
+		m_data  = buffer->data();
+		m_owner = std::move( buffer);
+	}
+
+	/*
+	 * View rows that already sit `stride` bytes apart in a buffer kept alive by
+	 * `owner`, without copying them.
+	 */
+	PuzzleGrid( std::shared_ptr<const void> owner, const char *data, size_t rows, size_t cols, size_t stride)
+		: m_owner( std::move( owner)), m_data( data), m_rows( rows), m_cols( cols), m_stride( stride)
+	{
+	}
+
+	size_t rows() const
+	{
+		return m_rows;
+	}
+
+	size_t cols() const
+	{
+		return m_cols;
+	}
+
+	/*
+	 * Distance in bytes between the starts of two consecutive rows.
+	 */
+	size_t stride() const
+	{
+		return m_stride;
+	}
+
+	bool empty() const
+	{
+		return m_rows == 0 || m_cols == 0;
+	}
+
+	const char *data() const
+	{
+		return m_data;
+	}
+
+	std::string_view row( size_t i) const
+	{
+		return { m_data + i * m_stride, m_cols};
+	}
+
+	char at( size_t i, size_t j) const
+	{
+		return m_data[ i * m_stride + j];
+	}
+
+	// Container-like access, so row oriented code can keep reading grid[ i][ j].
+	size_t size() const
+	{
+		return m_rows;
+	}
+
+	std::string_view operator[]( size_t i) const
+	{
+		return row( i);
+	}
+
+	std::string_view front() const
+	{
+		return row( 0);
+	}
+
+	/*
+	 * Letters the cells past ASCII stand for; null when there are none.
+	 */
+	const Alphabet *alphabet() const
+	{
+		return m_alphabet.get();
+	}
+
+	/*
+	 * The same grid, with the cells past ASCII standing for `alphabet`.
+	 */
+	PuzzleGrid spelledWith( std::shared_ptr<const Alphabet> alphabet) const
+	{
+		auto grid = *this;
+		grid.m_alphabet = std::move( alphabet);
+		return grid;
+	}
+
+	/*
+	 * UTF-8 text of `cells`, taken from this grid or from a key of its puzzle.
+	 */
+	std::string spell( std::string_view cells) const
+	{
+		if( !m_alphabet)
+			return std::string( cells);
+		std::string text;
+		m_alphabet->spell( cells, text);
+		return text;
+	}
+
+private:
+	std::shared_ptr<const void> m_owner;
+	const char *m_data{ nullptr};
+	size_t m_rows{}, m_cols{}, m_stride{};
+	std::shared_ptr<const Alphabet> m_alphabet;
+};
+
+}
+
+#endif //PUZZLER_PUZZLE_GRID_HPP
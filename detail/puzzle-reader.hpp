@@ -0,0 +1,268 @@
+#ifndef PUZZLER_PUZZLE_READER_HPP
+#define PUZZLER_PUZZLE_READER_HPP
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "alphabet.hpp"
+#include "mapped-file.hpp"
+#include "puzzle-grid.hpp"
+#include "solution-cache.hpp"
+#include "stats.hpp"
+
+/*
+ * A puzzle as read from a file. The grid and the keys are views into the
+ * reader's buffer whenever the file spells them out as plain upper case letters, so the
+ * reader has to outlive the keys. Letters past ASCII are ids of the grid's
+ * alphabet, in the keys as in the grid.
+ */
+struct PuzzleImage
+{
+	detail::PuzzleGrid puzzle;
+	std::vector<std::string_view> keys;
+	detail::KnownSolution solution{};   // Only compiled archives come with one.
+};
+
+class PuzzleFileReader
+{
+public:
+	explicit PuzzleFileReader( std::istream& strm )
+	{
+		auto buffer = std::make_shared<std::string>( std::istreambuf_iterator<char>( strm ),
+		                                             std::istreambuf_iterator<char>() );
+		m_text  = *buffer;
+		m_owner = std::move( buffer );
+		ignoreBOM();
+	}
+	explicit PuzzleFileReader( std::shared_ptr<const detail::MappedFile> file )
+	: m_text( file->view() ), m_owner( std::move( file ) )
+	{
+		ignoreBOM();
+	}
+	PuzzleFileReader operator=( const PuzzleFileReader& ) = delete;
+	PuzzleFileReader( const PuzzleFileReader& )           = delete;
+	const std::vector<PuzzleImage>& getPuzzles()
+	{
+		if( !has_processed)
+		{
+			while( auto image = next() )
+				m_puzzles.push_back( std::move( *image ) );
+			has_processed = true;
+		}
+
+		return m_puzzles;
+	}
+
+	/*
+	 * Parse just far enough to complete the next puzzle, so puzzles can be
+	 * consumed while the rest of the file is still unread.
+	 */
+	std::optional<PuzzleImage> next()
+	{
+		detail::Stats::Timer timer( detail::Stats::PARSE );
+        constexpr auto PUZZLE = std::string_view{ "puzzle:"};
+        constexpr auto KEY    = std::string_view{ "key:"};
+		bool plain;
+		for( std::string_view w; nextWord( w, plain ); )
+		{
+			if( m_mode != ParseMode::NILL && w.back() != ':' )
+			{
+				m_cur[ static_cast<int>(m_mode)-1 ].push_back( w );
+				m_plain_rows = m_plain_rows && ( m_mode != ParseMode::PUZZLE || plain );
+				continue;
+			}
+
+			std::optional<PuzzleImage> image;
+			if( m_mode != ParseMode::NILL && !m_cur[ 0].empty() && !m_cur[ 1].empty() )
+			{
+				image = PuzzleImage{ makeGrid( m_cur[ 0], m_plain_rows ), makeKeys( m_cur[ 1] ) };
+				if( !m_alphabet.empty() )
+					image->puzzle = image->puzzle.spelledWith(
+						std::make_shared<const detail::Alphabet>( std::exchange( m_alphabet, {} ) ) );
+				m_cur[ 0].clear(); m_cur[ 1].clear();
+				m_plain_rows = true;
+			}
+
+			if( equalsIgnoreCase( w, PUZZLE ) )
+				m_mode = ParseMode::PUZZLE;
+			else if( equalsIgnoreCase( w, KEY ) )
+				m_mode = ParseMode::KEY;
+			else
+				m_mode = ParseMode::NILL;
+
+			if( image )
+				return image;
+		}
+		return std::nullopt;
+	}
+private:
+
+	void ignoreBOM()
+	{
+		constexpr auto BOM = std::string_view{ "\xEF\xBB\xBF" };
+		if( m_text.substr( 0, BOM.size() ) == BOM )
+			m_text.remove_prefix( BOM.size() );
+	}
+
+	/*
+	 * Rows of plain upper case letters that are evenly spaced in the buffer
+	 * are viewed in place; anything else is cleaned up into a grid of its own.
+	 */
+	detail::PuzzleGrid makeGrid( const std::vector<std::string_view>& rows, bool plain_rows )
+	{
+		auto cols   = rows.front().size();
+		auto stride = rows.size() > 1 ? static_cast<size_t>( rows[ 1].data() - rows[ 0].data() ) : cols;
+		bool in_place = plain_rows && stride >= cols;
+		for( size_t i = 0; in_place && i < rows.size(); ++i )
+			in_place = rows[ i].size() == cols && rows[ i].data() == rows[ 0].data() + i * stride;
+		if( in_place )
+			return { m_owner, rows.front().data(), rows.size(), cols, stride };
+
+		std::vector<std::string> shaped_rows;
+		for( auto row : rows )
+			if( auto shaped_row = shaped( row, false ); !shaped_row.empty() )
+				shaped_rows.push_back( std::move( shaped_row ) );
+		return detail::PuzzleGrid( shaped_rows );
+	}
+
+	std::vector<std::string_view> makeKeys( const std::vector<std::string_view>& words )
+	{
+		std::vector<std::string_view> keys;
+		keys.reserve( words.size() );
+		for( auto w : words )
+		{
+			if( isPlain( w ) )
+				keys.push_back( w );
+			else if( auto shaped_word = shaped( w, true ); shaped_word.find_first_not_of( WILDCARD ) != std::string::npos )
+				keys.push_back( m_shaped.emplace_back( std::move( shaped_word ) ) );
+		}
+		return keys;
+	}
+
+	static constexpr char WILDCARD = '?';    // Any letter, to --max-errors searches.
+
+	enum CharClass : uint8_t
+	{
+		SEPARATOR = 1,
+		LETTER    = 2,
+		OTHER     = 4,
+		LOWER     = 8     // Along with LETTER, so lower case words are never plain.
+	};
+
+	// Classification of every byte, matching isalpha() in the "C" locale.
+	static constexpr std::array<uint8_t, 256> CLASSES = []
+	{
+		std::array<uint8_t, 256> classes{};
+		for( auto& cls : classes )
+			cls = OTHER;
+		for( int c = 'A'; c <= 'Z'; ++c )
+		{
+			classes[ static_cast<size_t>( c )]             = LETTER;
+			classes[ static_cast<size_t>( c - 'A' + 'a' )] = LETTER | LOWER;
+		}
+		for( auto c : { ' ', '\n', '\r', '\t' } )
+			classes[ static_cast<size_t>( c )] = SEPARATOR;
+		return classes;
+	}();
+
+	static uint8_t classOf( char c )
+	{
+		return CLASSES[ static_cast<uint8_t>( c )];
+	}
+
+	static bool isPlain( std::string_view given )
+	{
+		for( auto c : given )
+			if( classOf( c ) != LETTER )
+				return false;
+		return true;
+	}
+
+	/*
+	 * The letters of `given` alone, upper-cased, so grids and keys match
+	 * whatever case either is written in. Letters past ASCII become ids of
+	 * the puzzle's alphabet; once it is full, new ones are dropped like any
+	 * other character. Keys also keep their wildcards.
+	 */
+	std::string shaped( std::string_view given, bool key )
+	{
+		std::string new_s;
+		for( size_t i = 0; i < given.size(); )
+		{
+			if( static_cast<uint8_t>( given[ i] ) < detail::Alphabet::FIRST )
+			{
+				if( classOf( given[ i] ) & LETTER )
+					new_s += static_cast<char>( detail::Alphabet::upper( static_cast<uint8_t>( given[ i] ) ) );
+				else if( key && given[ i] == WILDCARD )
+					new_s += given[ i];
+				++i;
+				continue;
+			}
+			auto letter = detail::Alphabet::decode( given, i );
+			if( !detail::Alphabet::isLetter( letter ) )
+				continue;
+			if( auto id = m_alphabet.idOf( detail::Alphabet::upper( letter ) ) )
+				new_s += static_cast<char>( id );
+		}
+		return new_s;
+	}
+
+	static bool equalsIgnoreCase( std::string_view given, std::string_view lower )
+	{
+		if( given.size() != lower.size() )
+			return false;
+		for( size_t i = 0; i < given.size(); ++i )
+			if( tolower( static_cast<unsigned char>( given[ i] ) ) != lower[ i] )
+				return false;
+		return true;
+	}
+
+	/*
+	 * Cut the next whitespace separated token out of the buffer; `plain` tells
+	 * whether it is made of upper case letters only.
+	 */
+	bool nextWord( std::string_view& word, bool& plain )
+	{
+		auto size = m_text.size();
+		while( m_offset < size && classOf( m_text[ m_offset] ) == SEPARATOR )
+			++m_offset;
+		auto begin = m_offset;
+		uint8_t seen = 0, current;
+		while( m_offset < size && ( current = classOf( m_text[ m_offset] ) ) != SEPARATOR )
+		{
+			seen |= current;
+			++m_offset;
+		}
+		word  = m_text.substr( begin, m_offset - begin );
+		plain = seen == LETTER;
+		return !word.empty();
+	}
+
+	enum class ParseMode
+	{
+		NILL,
+		PUZZLE,
+		KEY
+	};
+	std::vector<PuzzleImage> m_puzzles;
+	std::vector<std::string_view> m_cur[ 2];
+	ParseMode m_mode{ ParseMode::NILL };
+	bool m_plain_rows{ true };
+	std::string_view m_text;
+	std::shared_ptr<const void> m_owner;
+	std::deque<std::string> m_shaped;   // Keys that had to be cleaned up, kept at stable addresses.
+	detail::Alphabet m_alphabet;        // Letters past ASCII of the puzzle being made.
+	size_t m_offset{};
+	bool has_processed{};
+};
+
+#endif //PUZZLER_PUZZLE_READER_HPP
@@ -9,20 +9,13 @@
 #include <climits>
 #include <utility>
 #include <list>
-#include <sys/epoll.h>
+#include <optional>
+#include <sys/ioctl.h>
 #include <cassert>
 #include "puzzle-solver.hpp"
 #include "option-builder.hpp"
-
-#define STRINGIFY_IMPL( cmd) #cmd
-#define STRINGIFY( cmd) STRINGIFY_IMPL( cmd)
-#define Q( value) ( *(STRINGIFY( value)))
-
-#define KEY_QUIT     q
-#define KEY_PAUSE    p
-#define KEY_RESTART  r
-#define KEY_NEXT     n
-#define KEY_PREVIOUS b
+#include "screen-buffer.hpp"
+#include "event-loop.hpp"
 
 namespace detail
 {
@@ -41,21 +34,18 @@ public:
 
 	void setWinSize( size_t v_rows, size_t v_cols)
 	{
-		static bool initial_run = true;
 		cols = v_cols;
 		lines = v_rows;
-		if( !initial_run)
-			EventDog::resized() = true;
-
-		if( update_callback)
-			update_callback( true);
-
-		initial_run = false;
 	}
 
-	static void registerWinUpdateCallback( const std::function<void( bool)>& cb)
+	/*
+	 * Read the terminal size into the shared instance.
+	 */
+	static void refreshWinSize()
 	{
-		EventDog::instance()->update_callback = cb;
+		struct winsize window_size{};
+		ioctl( STDIN_FILENO, TIOCGWINSZ, &window_size);
+		EventDog::instance()->setWinSize( window_size.ws_row, window_size.ws_col);
 	}
 
 	bool &paused()
@@ -63,11 +53,6 @@ public:
 		return is_paused;
 	}
 
-	static bool& resized()
-	{
-		return EventDog::instance()->is_resized;
-	}
-
 	static size_t getWinLines()
 	{
 		return EventDog::instance()->lines;
@@ -83,34 +68,11 @@ public:
 		return EventDog::instance()->is_first_focus;
 	}
 
-	static bool isReady( int ms)
-	{
-		struct timeval timeout = { 0, static_cast<long>( ms * 1000)};
-		fd_set rfds;
-		FD_ZERO( &rfds);
-		FD_SET( STDIN_FILENO, &rfds);
-		return ( select( STDIN_FILENO + 1, &rfds, nullptr, nullptr, ms == 0 ? nullptr : &timeout) > 0
-		         && FD_ISSET( STDIN_FILENO, &rfds));
-	}
-
 private:
 	EventDog() = default;
 	size_t cols{}, lines{};
-	bool is_paused{}, is_resized{},
+	bool is_paused{},
 	     is_first_focus{ true};
-	std::function<void( bool)> update_callback;
-};
-
-enum class  Event
-{
-	Resize,
-	Quit,
-	Pause,
-	Restart,
-	Focus,
-	Next,
-	Previous,
-	NoOp
 };
 
 enum class Conclusion
@@ -120,31 +82,15 @@ enum class Conclusion
 	Forward
 };
 
-inline Event watchEvent( int ms)
+/*
+ * Next event of the loop, with the window size already updated on a resize.
+ */
+inline Event nextEvent()
 {
-	if( EventDog::isReady( ms))
-	{
-		int input = std::getchar();
-		if( input == Q( KEY_QUIT))
-			return Event::Quit;
-		else if( input == Q( KEY_PAUSE))
-			return Event::Pause;
-		else if( input == Q( KEY_RESTART))
-			return Event::Restart;
-		else if( input == '\x1B')
-			return Event::Focus;
-		else if( input == Q( KEY_NEXT))
-			return Event::Next;
-		else if(input == Q( KEY_PREVIOUS))
-			return Event::Previous;
-	}
-	else if( EventDog::resized())
-	{
-		EventDog::resized() = false;
-		return Event::Resize;
-	}
-
-	return Event::NoOp;
+	auto event = EventLoop::instance().next();
+	if( event == Event::Resize)
+		EventDog::refreshWinSize();
+	return event;
 }
 
 }
@@ -169,19 +115,9 @@ protected:
 class TerminalPuzzleSimulator: public PuzzleSimulator
 {
 public:
-	explicit TerminalPuzzleSimulator( const PuzzleSolver& solver, const detail::OptionBuilder& options)
-		: PuzzleSimulator( solver, options)
+	explicit TerminalPuzzleSimulator( PuzzleSolver solver, const detail::OptionBuilder& options)
+		: PuzzleSimulator( std::move( solver), options)
 	{
-		auto clone = _solver.puzzle();
-		puzzle.resize( clone.size());
-		std::transform( clone.cbegin(), clone.cend(), puzzle.begin(),
-		                []( const auto& str)
-		                {
-			                std::vector<char> inner( str.size());
-			                std::copy( str.cbegin(), str.cend(), inner.begin());
-			                return inner;
-		                });
-		words = _solver.words();
 		longest_size = std::max_element( _solver.matches().cbegin(), _solver.matches().cend(),
                        []( auto& left, auto& right) { return left.word.size() < right.word.size();})
 		               ->word.size() + 2;
@@ -206,19 +142,26 @@ public:
 
 		size_t n_lines, padding, rem_lines, word_row, word_col;
 		size_t n_cols;
+		// Whatever is on the terminal now was not drawn by this simulator.
+		m_screen.invalidate();
 		auto populate = [&]()
 		{
-			printf("\x1B[2J\x1B[H");    // Clear screen and move cursor to origin
-			std::tie( n_lines, padding) = display( strm, puzzle_number);
+			m_screen.resize( detail::EventDog::getWinLines(), detail::EventDog::getWinCols());
+			m_screen.clear();
+			std::tie( n_lines, padding) = display( puzzle_number);
 			rem_lines = detail::EventDog::getWinLines() - n_lines;
 			n_cols = detail::EventDog::getWinCols() / longest_size;
 			word_row = word_col = 0;
 		};
 		populate();
 
+		// Set once the window changed size while paused, so the layout is
+		// redone and the progress replayed on resuming.
+		bool relayout = false;
 		auto restart = [&]( auto& b_soln, auto& reset)
 		{
 			reset = true;
+			relayout = false;
 			last_x_pos = last_y_pos = NEG_INF;
 			last_char = CHAR_MAX;
 			std::copy( base_order.cbegin(), base_order.cend(), soln.begin());
@@ -226,34 +169,53 @@ public:
 			populate();
 		};
 
+		auto& loop = detail::EventLoop::instance();
 		auto freeze = [&]( auto& b_soln, auto& reset)
 		{
+			if( !state_provider->paused())
+				return detail::Conclusion::Finished;
+
+			// Without ticks the loop sleeps until a key or a signal comes.
+			loop.stopTicks();
 			while( state_provider->paused())
 			{
-				int input = std::getchar();
-				if( input == Q( KEY_QUIT))
-					exit( EXIT_SUCCESS);
-				else if( input == Q( KEY_PAUSE))
-					state_provider->paused() = false;
-				else if( input == Q( KEY_RESTART))
+				switch( auto event = detail::nextEvent(); event)
 				{
-					state_provider->paused() = false;
-					restart( b_soln, reset);
-				}
-				else if( input == Q( KEY_NEXT) || input == Q( KEY_PREVIOUS))
-				{
-					fast_forward = state_provider->paused();
-					return input == Q( KEY_NEXT) ? detail::Conclusion::Forward : detail::Conclusion::Rewind;
+					case detail::Event::Quit:
+					case detail::Event::Interrupt:
+						exit( EXIT_SUCCESS);
+					case detail::Event::Pause:
+						state_provider->paused() = false;
+						break;
+					case detail::Event::Restart:
+						state_provider->paused() = false;
+						restart( b_soln, reset);
+						break;
+					case detail::Event::Next:
+					case detail::Event::Previous:
+						fast_forward = state_provider->paused();
+						return event == detail::Event::Next ? detail::Conclusion::Forward : detail::Conclusion::Rewind;
+					case detail::Event::Resize:
+						// Show the progress so far at the new size straight away.
+						simulate( strm, puzzle_number, true);
+						relayout = true;
+						break;
+					default:
+						break;
 				}
 			}
+			loop.startTicks( m_sim_speed);
 
 			return detail::Conclusion::Finished;
 		};
 
-		// Disable buffering in terminal
+		// Disable buffering in terminal, so the odd escape code printed outside
+		// of the screen buffer is not reordered with its frames.
 		setvbuf( stdout, nullptr, _IONBF, 0);
-		// Save current cursor position
-		printf( "\x1B[s");
+		// Frames are paced by the loop's timer, which only runs while this animates.
+		std::optional<detail::EventLoop::Ticks> ticks;
+		if( !refresh_run)
+			ticks.emplace( m_sim_speed);
 		bool reset;
 		for( auto b_soln = soln.begin(), e_soln = soln.end(); b_soln != e_soln; reset ? b_soln : ++b_soln)
 		{
@@ -267,31 +229,89 @@ public:
 			for( auto b_w = b_soln->word.begin(), e_w = b_soln->word.end(); !reset && b_w != e_w; ++b_w)
 			{
 				auto w = *b_w;
-				printf( "\x1B[%d;%dH\x1B[%dm%c\x1B[0m\x1B", 
-                        m.start.x + 1 + 2, 
-                        3 *  m.start.y + static_cast<int>( padding),
-				        color, 
-                        puzzle[ static_cast<size_t>( m.start.x)][ static_cast<size_t>( m.start.y)]);
+				auto letter = puzzle().at( static_cast<size_t>( m.start.x), static_cast<size_t>( m.start.y));
+				m_screen.put( static_cast<size_t>( m.start.x) + 2, left( padding) + 3 * static_cast<size_t>( m.start.y),
+				              puzzle().spell( { &letter, 1}), static_cast<uint16_t>( color));
 				if( fast_forward || refresh_run)
 				{
 					if( last_char ==  w && last_x_pos == m.start.x && last_y_pos == m.start.y)
 					{
 						if( refresh_run)
+						{
+							m_screen.present( strm);
 							return detail::Conclusion::Rewind;
+						}
 
 						fast_forward = false;
 					}
 				}
 				else
 				{
+					// One frame per highlighted letter, sent before waiting on the next tick.
+					m_screen.present( strm);
 					{
 						auto result = freeze( b_soln, reset);
 						if ( result != detail::Conclusion::Finished)
 							return result;
 					}
-					switch( detail::watchEvent( m_sim_speed))
+					// Keys are handled as they come, but the next letter waits for its tick.
+					for( bool ticked = false; !ticked && !reset;)
 					{
-						case detail::Event::Resize:
+						switch( auto event = detail::nextEvent(); event)
+						{
+							case detail::Event::Tick:
+								ticked = true;
+								break;
+							case detail::Event::Resize:
+								relayout = true;
+								break;
+							case detail::Event::Quit:
+							case detail::Event::Interrupt:
+								exit( EXIT_SUCCESS);
+							case detail::Event::Pause:
+							{
+								last_x_pos = m.start.x;
+								last_y_pos = m.start.y;
+								last_char  = w;
+								state_provider->paused() = true;
+								auto result = freeze( b_soln, reset);
+								if( result != detail::Conclusion::Finished)
+									return result;
+								break;
+							}
+							case detail::Event::Restart:
+								restart( b_soln, reset);
+								break;
+							case detail::Event::FocusIn:
+							case detail::Event::FocusOut:
+								// The first focus is a false trigger. Discard it.
+								if( !detail::EventDog::firstFocus())
+								{
+									if( event == detail::Event::FocusIn)
+										state_provider->paused() = false;
+									else
+									{
+										last_x_pos = m.start.x;
+										last_y_pos = m.start.y;
+										last_char  = w;
+										state_provider->paused() = true;
+										auto result = freeze( b_soln, reset);
+										if( result != detail::Conclusion::Finished)
+											return result;
+									}
+								}
+								detail::EventDog::firstFocus() = false;
+								break;
+							case detail::Event::Next:
+								return detail::Conclusion::Forward;
+							case detail::Event::Previous:
+								return detail::Conclusion::Rewind;
+							case detail::Event::NoOp:
+								break;
+						}
+						if( relayout)
+						{
+							relayout = false;
 							fast_forward = reset = true;
 							last_x_pos = m.start.x;
 							last_y_pos = m.start.y;
@@ -299,124 +319,49 @@ public:
 							std::copy( base_order.cbegin(), base_order.cend(), soln.begin());
 							b_soln = soln.begin();
 							populate();
-							continue;
-						case detail::Event::Quit:
-							exit( EXIT_SUCCESS);
-						case detail::Event::Pause:
-						{
-							last_x_pos = m.start.x;
-							last_y_pos = m.start.y;
-							last_char  = w;
-							state_provider->paused() = true;
-							auto result = freeze( b_soln, reset);
-							if( result != detail::Conclusion::Finished)
-								return result;
-							break;
-						}
-						case detail::Event::Restart:
-							restart( b_soln, reset);
-							continue;
-						case detail::Event::Focus:
-						{
-							char remaining[ 3]{};
-							// The first focus is a false trigger. Discard it.
-							if( !detail::EventDog::firstFocus() && read(STDIN_FILENO, remaining, 2) == 2)
-							{
-								if( strcmp( remaining, "[I") == 0)
-									state_provider->paused() = false;
-								else if( strcmp( remaining, "[O") == 0)
-								{
-									last_x_pos = m.start.x;
-									last_y_pos = m.start.y;
-									last_char  = w;
-									state_provider->paused() = true;
-									freeze( b_soln, reset);
-								}
-							}
-							detail::EventDog::firstFocus() = false;
-							break;
 						}
-						case detail::Event::Next:
-							return detail::Conclusion::Forward;
-						case detail::Event::Previous:
-							return detail::Conclusion::Rewind;
-						case detail::Event::NoOp:
-							break;
 					}
 				}
 
-				m.start = PuzzleSolver::next( m.dmatch )( m.start);
+				m.start = PuzzleSolver::next( m.dmatch, m.start);
 			}
 			if( rem_lines > 0 && !reset)
 			{
 				// Display search complete indicator for word.
-				auto current_word = ( m.reversed ? detail::util::reversed( m.word) : m.word)
+				auto current_word = puzzle().spell( m.reversed ? detail::util::reversed( m.word) : m.word)
 					.append( std::string( static_cast<size_t>( longest_size) - m.word.size(), ' '));
-				printf( "\x1B[%lu;%zuH\x1B[%dm%s", n_lines + (word_row % rem_lines),
-				        (( word_row > 0 && ( word_row % rem_lines == 0) ? ++word_col
-				         : word_col) % n_cols) * longest_size, color, current_word.c_str());
+				auto slot = (( word_row > 0 && ( word_row % rem_lines == 0) ? ++word_col : word_col) % n_cols) * longest_size;
+				m_screen.put( n_lines - 1 + word_row % rem_lines, slot > 0 ? slot - 1 : 0, current_word,
+				              static_cast<uint16_t>( color));
 				++word_row;
 			}
 		}
-		// We are done! Restore cursor position
-		printf("\x1B[u");
+		// We are done! Leave the cursor below the grid.
+		m_screen.park( m_park_row, m_park_col);
+		m_screen.present( strm);
 
 		return detail::Conclusion::Finished;
 	}
 
 private:
 
-#if defined( __GNUC__) || defined( __clang__)
-#define popcount8( x) __builtin_popcount( x)
-#else
-	#define popcount8(x)                                \
-        do {                                            \
-              uint8_t v = x;                            \
-              v = ( v & 0x55) << 1 | (( v >> 1) & 0x55); \
-              v = ( v & 0x33) << 1 | (( v >> 1) & 0x33); \
-              v = ( v & 0x0F) << 1 | (( v >> 1) & 0x0F); \
-        }while( 0);
-#endif
-
-	static int byteCount( uint8_t c)
-	{
-		// Check if leading byte is an ASCII character
-		if(( c & 0x80) != 0x80)
-			return 1;
-		// If not, reverse the byte
-		c = static_cast<uint8_t>(( c &  0x55) << 1) | ( c & 0xAA) >> 1;
-		c = static_cast<uint8_t>(( c &  0x33) << 2) | ( c & 0xCC) >> 2;
-		c = static_cast<uint8_t>(( c &  0x0F) << 4) | ( c & 0xFF) >> 4;
-		// Mask out the continuous runs of ones in the leading byte( now trailing)
-		c = ( c ^ ( c + 1)) >> 1;
-		// Count the remaining bits in the byte.
-		return popcount8( c);
-	}
-
-	static size_t mb_strsize( const char *ps)
-	{
-		size_t iters = 0;
-		while( *ps)
-		{
-			ps += byteCount( static_cast<uint8_t>( *ps));
-			++iters;
-		}
-
-		return iters;
-	}
-
-	std::pair<int, int> display( std::ostream& strm, size_t puzzle_number = 1)
+	/*
+	 * Draw the heading, the grid, the controls and the found words header into
+	 * the back buffer; returns the first line below them and the grid padding.
+	 */
+	std::pair<int, int> display( size_t puzzle_number = 1)
 	{
+		detail::Stats::Timer timer( detail::Stats::DISPLAY);
 		auto rows = detail::EventDog::getWinLines(),
 			 cols = detail::EventDog::getWinCols();
-		auto cols_padding = ((int)(cols - 3 * puzzle.size() + 1)) / 2;
-		if( 0 > cols_padding || puzzle.front().size() > rows)
+		auto& puzzle = this->puzzle();
+		auto cols_padding = ((int)(cols - 3 * puzzle.cols() + 1)) / 2;
+		if( 0 > cols_padding || puzzle.rows() > rows)
 			panic_exit();
 
 		std::string heading( "Puzzle #" + std::to_string( puzzle_number));
-		strm << std::setw((int)(cols - heading.size()) / 2)
-			 << "\x1B[4m" << heading << "\x1B[24m" <<"\n\n";
-		auto n_lines = static_cast<int>( 2 + puzzle.size());
+		m_screen.put( 0, ( cols - std::min( cols, heading.size())) / 2, heading, detail::ScreenBuffer::UNDERLINE);
+		auto n_lines = static_cast<int>( 2 + puzzle.rows());
 		std::array control_info = {
 			"╭──────────────────────╮",
 			"│                      │",
@@ -435,42 +380,55 @@ private:
 			"╰───────────┴──────────╯"
 		};
 
-		for( auto & makeup : puzzle)
+		if( !_options.asBool( "matches-only"))
 		{
-			strm << std::setw( cols_padding);
-			if( !_options.asBool( "matches-only"))
+			for( size_t i = 0; i < puzzle.rows(); ++i)
 			{
-				for( std::size_t j = 0, j_size = makeup.size(); j < j_size; ++j )
-					strm << makeup[ j] << ( j + 1 == j_size ? "" : "  ");
+				auto makeup = puzzle.row( i);
+				for( std::size_t j = 0; j < makeup.size(); ++j)
+					m_screen.put( 2 + i, left( static_cast<size_t>( cols_padding)) + 3 * j, puzzle.spell( makeup.substr( j, 1)));
 			}
-			strm <<'\n';
 		}
 
-		auto max_text_size = static_cast<int>( mb_strsize( control_info.front()));
-		if( max_text_size < cols_padding && control_info.size() < ( puzzle.size() + 4))
+		auto max_text_size = static_cast<int>( detail::util::mb_strsize( control_info.front()));
+		if( max_text_size < cols_padding && control_info.size() < ( puzzle.rows() + 4))
 		{
-			auto v_align = ( 4 + static_cast<int>( puzzle.size()) - static_cast<int>( control_info.size())) / 2,
+			auto v_align = ( 4 + static_cast<int>( puzzle.rows()) - static_cast<int>( control_info.size())) / 2,
 				 h_align = ( cols_padding - max_text_size) / 2;
 			for( size_t i = 0; i < control_info.size(); ++i)
-            {
-				printf( "\x1B[%d;%dH%s", 
-                        v_align + static_cast<int>( i), 
-                        h_align, 
-                        control_info[ i]);
-            }
-			printf( "\x1B[%d;%dH", n_lines + 1, 0);
+				m_screen.put( static_cast<size_t>( std::max( v_align + static_cast<int>( i) - 1, 0)),
+				              static_cast<size_t>( std::max( h_align - 1, 0)), control_info[ i]);
 		}
 
 		auto remaining_lines = (int)rows - (int)n_lines;
 		if( remaining_lines <= 0)
 			panic_exit();
 
+		m_park_row = static_cast<size_t>( n_lines);
+		m_park_col = 0;
 		if( remaining_lines - 4 > 0)
-			strm << "\n\n\x1B[4m\x1B[1mFound Words\x1B[24m\x1B[22m:";
+		{
+			constexpr std::string_view title = "Found Words";
+			m_park_row += 2;
+			m_park_col  = title.size() + 1;
+			m_screen.put( m_park_row, 0, title, static_cast<uint16_t>( detail::ScreenBuffer::UNDERLINE | detail::ScreenBuffer::BOLD));
+			m_screen.put( m_park_row, title.size(), ":");
+		}
 		n_lines += 4;
 		return { n_lines, cols_padding};
 	}
 
+	// Column of the grid's first letter for a given padding.
+	static size_t left( size_t padding)
+	{
+		return padding > 0 ? padding - 1 : 0;
+	}
+
+	const detail::PuzzleGrid& puzzle() const
+	{
+		return _solver.puzzle();
+	}
+
 	static void panic_exit()
 	{
 		const auto win_width = detail::EventDog::getWinCols();
@@ -494,8 +452,6 @@ private:
 		return dist( gen);
 	}
 
-	std::vector<std::vector<char>> puzzle;
-	std::vector<std::string> words;
 	std::unordered_map<std::string, int> color_selection;
 	int last_x_pos{ NEG_INF},
 		last_y_pos{ NEG_INF};
@@ -503,6 +459,8 @@ private:
 	bool fast_forward{};
 	char last_char{ CHAR_MAX};
 	int m_sim_speed = 1000/2;
+	detail::ScreenBuffer m_screen;
+	size_t m_park_row{}, m_park_col{};
 
 };
 
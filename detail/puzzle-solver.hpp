@@ -1,10 +1,12 @@
 ﻿#ifndef __PUZZLE_SOLVER_HPP
 #define __PUZZLE_SOLVER_HPP
 
+#include <atomic>
 #include <cstddef>
+#include <mutex>
 #include <utility>
 #include <vector>
-#include <forward_list>
+#include <array>
 #include <functional>
 #include <unordered_map>
 #include <iostream>
@@ -12,7 +14,19 @@
 #include <unordered_set>
 #include <fstream>
 #include <random>
+#include <optional>
+#include <string_view>
+#include <tuple>
 #include "utility.hpp"
+#include "puzzle-grid.hpp"
+#include "direction-lines.hpp"
+#include "aho-corasick.hpp"
+#include "simd-filter.hpp"
+#include "bitboard.hpp"
+#include "packed-lines.hpp"
+#include "thread-pool.hpp"
+#include "solution-cache.hpp"
+#include "stats.hpp"
 
 #define RED     1
 #define GREEN   1 + RED
@@ -24,9 +38,19 @@
 class PuzzleSolver
 {
 	struct ProgressTracker;
+	struct Coord;
 public:
 	
 	using underlying_type = ProgressTracker;
+
+	enum class Engine
+	{
+		Tracker,        // Row-major state machine that follows partial matches cell by cell.
+		AhoCorasick,    // Multi-pattern automaton run over every direction line.
+		Scan,           // Vectorised start-cell prefilter followed by full verification.
+		Bitboard,       // Letter bitboards ANDed along each direction, a whole row of starts at once.
+		Packed          // Scan's prefilter, verifying on direction lines packed 5 bits a letter.
+	};
 	
 	PuzzleSolver( const std::string& text, std::vector<std::string> words)
 	: m_words( std::move( words))
@@ -34,80 +58,448 @@ public:
 		preprocess();
 		buildPuzzle( text );
 	}
-	PuzzleSolver( std::vector<std::string> puzzle, std::vector<std::string> words)
+	PuzzleSolver( const std::vector<std::string>& puzzle, std::vector<std::string> words)
+	: PuzzleSolver( detail::PuzzleGrid( puzzle), std::move( words))
+	{
+	}
+	PuzzleSolver( detail::PuzzleGrid puzzle, const std::vector<std::string_view>& words)
+	: PuzzleSolver( std::move( puzzle), std::vector<std::string>( words.cbegin(), words.cend()))
+	{
+	}
+	PuzzleSolver( detail::PuzzleGrid puzzle, std::vector<std::string> words)
 	: m_puzzle( std::move( puzzle)), m_words( std::move( words))
 	{
 		preprocess();
 	}
+	void useEngine( Engine engine)
+	{
+		m_engine = engine;
+	}
+
+	/*
+	 * Let the aho-corasick and scan engines split a large grid into tiles and
+	 * solve them on `pool`; the matches are the same as when solved serially.
+	 * The pool has to outlive every call to solve().
+	 */
+	void useThreadPool( detail::ThreadPool *pool)
+	{
+		m_pool = pool;
+	}
+
+	static std::optional<Engine> engineFromName( std::string_view name)
+	{
+		if( name.empty() || name == "tracker")
+			return Engine::Tracker;
+		else if( name == "aho-corasick")
+			return Engine::AhoCorasick;
+		else if( name == "scan")
+			return Engine::Scan;
+		else if( name == "bitboard")
+			return Engine::Bitboard;
+		else if( name == "packed")
+			return Engine::Packed;
+		return std::nullopt;
+	}
+
+	/*
+	 * Look every solve() up in `cache` first, and store what it finds there
+	 * when it is not in yet. The cache has to outlive every call to solve().
+	 */
+	void useCache( detail::SolutionCache *cache)
+	{
+		m_cache = cache;
+	}
+
+	/*
+	 * Take the matches from `known` instead of solving; whichever engine found
+	 * them, they are the ones this one would. They have to outlive every call
+	 * to solve().
+	 */
+	void useKnownSolution( const detail::KnownSolution& known)
+	{
+		m_known = known;
+	}
+
 	void solve()
 	{
-		solve_();
-		if( m_completed.size() != m_words.size() )
+		detail::Stats::count( detail::Stats::PUZZLES_SOLVED);
+		if( m_known.matches && restore( m_known.matches, m_known.size))
+			return;
+		if( !m_cache)
 		{
-			m_tracker.clear();
-			for( const auto& w : m_words )
-				if( !m_found[ w ] )
-					m_rev_words.push_back( detail::util::reversed( w ) );
-			for( const auto& nw : m_rev_words )
-			{
-				ProgressTracker rev{ nw, nw.size() - 1};
-				rev.reversed = true;
-				m_tracker[ nw.front() ].emplace_front( rev );
-			}
-			solve_();
+			solveUncached_();
+			return;
 		}
+
+		auto key = cacheKey();
+		if( auto cached = m_cache->lookup( key); cached && restore( cached->data(), cached->size()))
+			return;
+		solveUncached_();
+		m_cache->store( key, solution());
 	}
-	
-	auto matches() const
+
+	/*
+	 * matches() in the compact form caches and archives keep: every match
+	 * refers to its key by index.
+	 */
+	std::vector<detail::SolutionCache::Match> solution() const
+	{
+		std::unordered_map<std::string_view, uint32_t> keys;
+		for( size_t i = m_words.size(); i-- > 0;)
+			keys[ m_words[ i]] = static_cast<uint32_t>( i);
+
+		std::vector<detail::SolutionCache::Match> entry;
+		for( const auto& m : m_completed )
+		{
+			auto word = m.reversed ? detail::util::reversed( m.word ) : m.word;
+			entry.push_back( { keys.at( word), m.start.x, m.start.y,
+			                   static_cast<uint8_t>( m.dmatch ), static_cast<uint8_t>( m.reversed ) } );
+		}
+		return entry;
+	}
+
+	const auto& matches() const
 	{
 		return m_completed;
 	}
 	
-	auto puzzle() const
+	const detail::PuzzleGrid& puzzle() const
 	{
 		return m_puzzle;
 	}
 	
-	auto words() const
+	const auto& words() const
 	{
 		return m_words;
 	}
+
+	/*
+	 * One occurrence of a key: the cell of its first letter and the direction
+	 * it reads in from there.
+	 */
+	struct Occurrence
+	{
+		size_t key;     // Index into words().
+		int row, col;
+		detail::Dir direction;
+	};
+
+	/*
+	 * Call sink( occurrence) for every occurrence of every key, overlapping
+	 * ones and ones read in opposite directions included, as soon as it is
+	 * found. One automaton runs over each line of the grid and then over it
+	 * backwards, so nothing is kept per occurrence however many there are.
+	 * Independent of the engine and of matches().
+	 */
+	template<typename Sink>
+	void forEachOccurrence( Sink&& sink) const
+	{
+		detail::DirectionLines lines( m_puzzle);
+		detail::AhoCorasick automaton( m_words);
+		for( const auto& line : lines.lines())
+		{
+			auto text = lines.text( line);
+			auto cell = [ &line]( size_t k) -> Coord
+			{
+				return { line.x + static_cast<int>( k) * line.dx, line.y + static_cast<int>( k) * line.dy };
+			};
+			// Single letters read the same every way; they are counted once, along S like matches().
+			auto single = line.direction == detail::Dir::ST;
+			automaton.scan( text.cbegin(), text.cend(), [ &]( size_t key, size_t end)
+			{
+				auto length = automaton.patternLength( key);
+				if( length > 1 || single)
+				{
+					auto start = cell( end + 1 - length);
+					sink( Occurrence{ key, start.x, start.y, line.direction});
+				}
+			});
+			automaton.scan( text.crbegin(), text.crend(), [ &]( size_t key, size_t end)
+			{
+				if( automaton.patternLength( key) > 1)
+				{
+					auto start = cell( text.size() - 1 - end + automaton.patternLength( key) - 1);
+					sink( Occurrence{ key, start.x, start.y, detail::opposite( line.direction)});
+				}
+			});
+		}
+	}
 	
-	static auto next( detail::Dir direction )
+	/*
+	 * The cell one step from `pos` along `direction`; NL leads off the grid.
+	 */
+	static constexpr Coord next( detail::Dir direction, Coord pos )
 	{
-		return m_dirlookup[ direction ];
+		if( direction == detail::Dir::NL )
+			return {};
+		return { pos.x + detail::DIR_DX[ static_cast<int>( direction )], pos.y + detail::DIR_DY[ static_cast<int>( direction )] };
 	}
 	
 private:
+	void solveUncached_()
+	{
+		if( m_engine == Engine::AhoCorasick)
+		{
+			solveLines_();
+			return;
+		}
+		else if( m_engine == Engine::Scan || m_engine == Engine::Packed)
+		{
+			solveScan_();
+			return;
+		}
+		else if( m_engine == Engine::Bitboard)
+		{
+			solveBitboard_();
+			return;
+		}
+
+		solve_();
+	}
+
+	/*
+	 * Everything the matches depend on: the grid and the keys in order, and
+	 * the letters the grid's ids past ASCII stand for. Every engine settles
+	 * on the same occurrence of a key, so they share their entries.
+	 */
+	detail::Sha256::Digest cacheKey() const
+	{
+		detail::Sha256 hash;
+		uint64_t shape[] = { m_puzzle.rows(), m_puzzle.cols() };
+		hash.update( "puzzler-solution-2" );
+		hash.update( shape, sizeof shape );
+		for( size_t i = 0; i < m_puzzle.rows(); ++i )
+			hash.update( m_puzzle.row( i ) );
+		for( const auto& w : m_words )
+			hash.update( w.c_str(), w.size() + 1 );
+		if( auto alphabet = m_puzzle.alphabet() )
+			for( uint32_t letter : alphabet->letters() )
+				hash.update( &letter, sizeof letter );
+		return hash.digest();
+	}
+
+	/*
+	 * Take the matches from a cache entry or an archive; false, with nothing
+	 * taken, if they do not fit the keys.
+	 */
+	bool restore( const detail::SolutionCache::Match *matches, size_t size)
+	{
+		std::vector<Placement> best( m_words.size());
+		for( auto m = matches; m != matches + size; ++m )
+		{
+			if( m->key >= m_words.size() || m->direction == 0 || m->direction > 8 )
+				return false;
+			best[ m->key] = { { m->row, m->col}, detail::Dir( m->direction ), m->reversed != 0 };
+		}
+		complete( best);
+		return true;
+	}
+
+	/*
+	 * The tracker engine: one sweep over the grid that follows every key
+	 * both as written and spelled backwards, along the directions that read
+	 * in scan order. Each word keeps the best match found so far by the rule
+	 * of Placement::preferredTo, and its trackers are dropped once they
+	 * cannot beat it. A key read backwards only counts when it cannot be read
+	 * forwards, so the trackers of a word that is only a reversal go as soon
+	 * as the key is found forwards.
+	 */
 	void solve_()
 	{
-		for( size_t i = 0; i < m_puzzle.size(); ++i )
+		detail::Stats::Timer timer( detail::Stats::TRACKER_PASS);
+		releaseTrackers();
+		m_settled.assign( m_spans.size(), false );
+		m_live.assign( m_spans.size(), 0 );
+		m_best.assign( m_spans.size(), {} );
+		for( uint32_t id = 0; id < m_spans.size(); ++id )
+		{
+			if( m_spans[ id].second == 0 )
+				continue;
+			Tracker root{};
+			root.word = id;
+			track( root );
+		}
+
+		for( size_t i = 0; i < m_puzzle.rows(); ++i )
 		{
-			for( size_t j = 0; j < m_puzzle[ i].size(); ++j )
+			for( size_t j = 0; j < m_puzzle.cols(); ++j )
 			{
-				auto match = m_tracker.find( m_puzzle[ i][ j] );
-				if( match == m_tracker.cend() ) continue ;
-				step( match->second, { static_cast<int>(i),  static_cast<int>(j) } );
-				removeStalePath( match->second );
+				auto letter = static_cast<uint8_t>( m_puzzle.at( i, j ) );
+				if( !m_listed[ letter] ) continue ;
+				step( letter, { static_cast<int>(i),  static_cast<int>(j) } );
+				// Stale trackers are mostly dropped as their letter comes up; the
+				// ones waiting for letters that rarely do are swept out in bulk.
+				if( m_stale > m_stale_kept + std::max<size_t>( m_tracking / 2, COMPACT_MIN ) )
+					compactTrackers();
 			}
 		}
+
+		// A key's reversal found along scan order is the key read against it.
+		std::vector<Placement> best( m_words.size() );
+		for( size_t k = 0; k < m_words.size(); ++k )
+		{
+			offer( best, k, m_best[ m_key_ids[ k]] );
+			auto backward = m_best[ m_reversed_ids[ k]];
+			backward.reversed = true;
+			offer( best, k, backward );
+		}
+		complete( best );
 	}
 	
-	void removeStalePath( std::forward_list<ProgressTracker>& match )
+	/*
+	 * Run one automaton over every row, column and diagonal, forwards and
+	 * backwards, instead of stepping trackers from cell to cell. Lines are
+	 * independent, so they are shared out between the tiles.
+	 */
+	void solveLines_()
 	{
-		match.remove_if( [this]( auto& elm )
+		detail::DirectionLines lines( m_puzzle);
+		detail::AhoCorasick automaton( m_words);
+		std::vector<Placement> best( m_words.size());
+		std::mutex merging;
+		const auto& all = lines.lines();
+		auto grain = TILE_CELLS / std::max<size_t>( 1, std::max( m_puzzle.rows(), m_puzzle.cols()));
+		forEachTile( all.size(), grain, [ &]( size_t first, size_t last)
+		{
+			std::vector<Placement> found( m_words.size());
+			for( auto l = first; l < last; ++l)
+			{
+				const auto& line = all[ l];
+				auto text = lines.text( line);
+				auto cell = [ &line]( size_t k) -> Coord
+				{
+					return { line.x + static_cast<int>( k) * line.dx, line.y + static_cast<int>( k) * line.dy };
+				};
+				automaton.scan( text.cbegin(), text.cend(), [ &]( size_t key, size_t end)
+				{
+					offer( found, key, { cell( end + 1 - automaton.patternLength( key)), line.direction, false});
+				});
+				// A key read against the line is recorded as its reversed spelling along the line.
+				automaton.scan( text.crbegin(), text.crend(), [ &]( size_t key, size_t end)
+				{
+					offer( found, key, { cell( text.size() - 1 - end), line.direction, true});
+				});
+			}
+			std::lock_guard<std::mutex> lock( merging);
+			for( size_t key = 0; key < found.size(); ++key)
+				offer( best, key, found[ key]);
+		});
+		complete( best);
+	}
+
+	/*
+	 * For every key, rule out most cells with vector compares of its first two
+	 * letters and only verify the remaining candidates, letter by letter or,
+	 * for the packed engine, twelve letters to a compare. Tiles
+	 * are bands of rows; a band still reads the rows below it, up to the longest
+	 * key, to verify candidates that run out of it.
+	 */
+	void solveScan_()
+	{
+		std::vector<Placement> best( m_words.size());
+		if( m_puzzle.empty())
+		{
+			complete( best);
+			return;
+		}
+
+		for( size_t key = 0; key < m_words.size(); ++key)
+			if( m_words[ key].size() == 1)
+				best[ key] = firstCell( m_words[ key].front());
+
+		// Row of the earliest forward match of each key found so far by any band.
+		std::vector<std::atomic<size_t>> forward_row( m_words.size());
+		for( auto& row : forward_row)
+			row = SIZE_MAX;
+		// Keys of other letters than A-Z are still verified a byte at a time.
+		std::optional<detail::PackedLines> packed;
+		std::vector<std::optional<detail::PackedKey>> packed_keys( m_words.size());
+		if( m_engine == Engine::Packed)
+		{
+			packed.emplace( m_puzzle);
+			for( size_t key = 0; key < m_words.size(); ++key)
+				packed_keys[ key] = detail::PackedLines::pack( m_words[ key]);
+		}
+		std::mutex merging;
+		forEachTile( m_puzzle.rows(), TILE_CELLS / m_puzzle.cols(), [ &]( size_t first, size_t last)
 		{
-			return elm.invalid == true || m_found.find( elm.word ) != m_found.cend();
+			std::vector<Placement> found( m_words.size());
+			scanRows( first, last, found, forward_row, packed ? &*packed : nullptr, packed_keys);
+			std::lock_guard<std::mutex> lock( merging);
+			for( size_t key = 0; key < found.size(); ++key)
+				offer( best, key, found[ key]);
 		});
-		for( auto& [ _,v ] : m_tracker )
-			v.remove_if( [this]( auto& elm ){ return m_found.find( elm.word ) != m_found.cend(); });
+		complete( best);
+	}
+
+	/*
+	 * Match every key against per-letter bitboards of the grid; keys are
+	 * independent, so they are the unit that is shared out between threads.
+	 */
+	void solveBitboard_()
+	{
+		std::vector<Placement> best( m_words.size());
+		if( !m_puzzle.empty())
+		{
+			detail::LetterBoards boards( m_puzzle, m_words);
+			auto row_words = m_puzzle.rows() * ( m_puzzle.cols() / 64 + 1);
+			forEachTile( m_words.size(), TILE_CELLS / row_words, [ &]( size_t first, size_t last)
+			{
+				for( auto key = first; key < last; ++key)
+					best[ key] = boardPlacement( boards, m_words[ key]);
+			});
+		}
+		complete( best);
+	}
+
+	/*
+	 * Hand [0, n) to `solve( first, last)` in pieces of at least `grain`, on
+	 * the thread pool when there is one and the work is worth splitting.
+	 */
+	template<typename Fn>
+	void forEachTile( size_t n, size_t grain, Fn&& solve) const
+	{
+		grain = std::max<size_t>( 1, grain);
+		auto tiles = m_pool ? std::min( n / grain, 8 * m_pool->size()) : 0;
+		if( tiles < 2)
+		{
+			solve( 0, n);
+			return;
+		}
+		m_pool->parallelFor( tiles, [ &]( size_t t) { solve( n * t / tiles, n * ( t + 1) / tiles); });
+	}
+
+	/*
+	 * Unlink every tracker of a settled word that cannot beat its match from
+	 * every list. The few that can are not counted towards the next sweep.
+	 */
+	void compactTrackers()
+	{
+		detail::Stats::Timer timer( detail::Stats::STALE_SWEEP);
+		for( auto& head : m_waiting )
+		{
+			for( auto link = &head; *link != NIL; )
+			{
+				auto index = *link;
+				if( m_settled[ m_trackers[ index].word] && !promising( m_trackers[ index] ) )
+				{
+					*link = m_trackers[ index].next;
+					release( index );
+				}
+				else
+					link = &m_trackers[ index].next;
+			}
+		}
+		m_stale_kept = m_stale;
 	}
 	
 	void buildPuzzle( const std::string& text )
 	{
+		std::vector<std::string> lines;
 		for( std::size_t offset{ 0 }; offset < text.size(); ++offset )
 			if( auto line = nextLine( text, offset ); !line.empty() )
-				m_puzzle.push_back( line );
+				lines.push_back( line );
+		m_puzzle = detail::PuzzleGrid( lines );
 	}
 	
 	static std::string nextLine( const std::string& text, std::size_t& offset )
@@ -137,214 +529,493 @@ private:
 		bool reversed{ false }, invalid{ false };
 	};
 
-	struct ProgressTrackerHash
+	static constexpr uint32_t NIL = UINT32_MAX;
+	static constexpr size_t COMPACT_MIN = 256;               // Stale trackers worth a sweep of every list.
+
+	/*
+	 * What the tracker engine follows while it runs: a ProgressTracker that
+	 * names its word by interned id and sits in a pooled list of trackers
+	 * waiting for the same letter, linked by index.
+	 */
+	struct Tracker
 	{
-		std::size_t operator()( const ProgressTracker& state ) const
+		uint32_t word{}, next{ NIL };
+		size_t begin{};
+		detail::Dir dmatch{ detail::Dir::NL };
+		Coord pos{}, start{};
+	};
+
+	/*
+	 * Where a key was found, as reported by the engines that look at every
+	 * occurrence rather than stopping at the first one.
+	 */
+	struct Placement
+	{
+		Coord start{};
+		detail::Dir dmatch{ detail::Dir::NL };
+		bool reversed{ false };
+
+		bool found() const
 		{
-			return std::hash<std::string>{}( state.word );
+			return dmatch != detail::Dir::NL;
+		}
+
+		/*
+		 * Forward matches win over reversed ones, then the earliest start in
+		 * scan order and finally the lowest direction.
+		 */
+		bool preferredTo( const Placement& other) const
+		{
+			return !other.found()
+			       || std::make_tuple( reversed, start.x, start.y, static_cast<int>( dmatch))
+			          < std::make_tuple( other.reversed, other.start.x, other.start.y,
+			                             static_cast<int>( other.dmatch));
 		}
 	};
 
-	friend bool operator==( const ProgressTracker& l, const ProgressTracker& r )
+	static void offer( std::vector<Placement>& best, size_t key, const Placement& candidate)
 	{
-		return l.word == r.word;
+		if( candidate.found() && candidate.preferredTo( best[ key]))
+			best[ key] = candidate;
 	}
-	
-	void step( std::forward_list<ProgressTracker>& match, Coord pos )
+
+	void complete( const std::vector<Placement>& best)
 	{
-		for( auto& m : match )
+		for( size_t i = 0; i < best.size(); ++i)
 		{
-			ProgressTracker next{ m };
-			next.pos = pos;
-			if( m.dmatch == detail::Dir::NL )
+			if( !best[ i].found() || m_found[ m_words[ i]])
+				continue;
+
+			const auto& w = m_words[ i];
+			ProgressTracker tracker{ best[ i].reversed ? detail::util::reversed( w) : w, w.size() - 1};
+			tracker.begin    = tracker.end;
+			tracker.dmatch   = best[ i].dmatch;
+			tracker.start    = best[ i].start;
+			tracker.reversed = best[ i].reversed;
+			m_completed.insert( tracker);
+			m_found[ w] = true;
+		}
+	}
+
+	/*
+	 * Express a match in the orientation the tracker engine reports it in:
+	 * keys read against scan order become their reversed spelling along it.
+	 */
+	static Placement placed( Coord start, detail::Dir direction, size_t length)
+	{
+		auto d = static_cast<size_t>( direction);
+		if( direction == detail::Dir::ST || direction == detail::Dir::ET
+		    || direction == detail::Dir::SW || direction == detail::Dir::SE)
+			return { start, direction, false};
+
+		auto span = static_cast<int>( length) - 1;
+		return { { start.x + span * detail::DIR_DX[ d], start.y + span * detail::DIR_DY[ d]},
+		         detail::opposite( direction), true};
+	}
+
+	Placement firstCell( char letter) const
+	{
+		for( size_t i = 0; i < m_puzzle.size(); ++i)
+			if( auto j = m_puzzle[ i].find( letter); j != std::string_view::npos)
+				return { { static_cast<int>( i), static_cast<int>( j)}, detail::Dir::ST, false};
+		return {};
+	}
+
+	/*
+	 * Lowest placement of one key on the letter bitboards. Only the first
+	 * start in scan order matters for each direction, and the reversed
+	 * directions are tried only when no forward one has matched.
+	 */
+	Placement boardPlacement( const detail::LetterBoards& boards, const std::string& w) const
+	{
+		Placement best;
+		for( auto forward : { true, false})
+		{
+			for( auto direction : forward ? FORWARD : BACKWARD)
 			{
-				if( m.start.x == NEG_INF )
-					next.start = pos;
-				else
+				auto d = static_cast<size_t>( direction);
+				// A forward match further down cannot beat the one already found.
+				auto limit = best.found() ? static_cast<size_t>( best.start.x) + 1 : SIZE_MAX;
+				if( auto cell = boards.firstMatch( w, detail::DIR_DX[ d], detail::DIR_DY[ d],
+				                                   forward ? limit : SIZE_MAX))
 				{
-					next.dmatch = newDir( m.pos, pos );
-					if( next.dmatch == detail::Dir::NL )
-						continue ;
+					auto candidate = placed( { static_cast<int>( cell->first), static_cast<int>( cell->second)},
+					                         direction, w.size());
+					if( candidate.preferredTo( best))
+						best = candidate;
 				}
-				m_tracker[ next.word[ ++next.begin]].emplace_front( next);
 			}
-			else if( auto nd = newDir( m.pos, pos ); nd == m.dmatch )
-				m_tracker[ next.word[ ++next.begin]].emplace_front( next);
+			if( best.found())
+				break;
+		}
+		return best;
+	}
+
+	void scanRows( size_t first, size_t last, std::vector<Placement>& best,
+	               std::vector<std::atomic<size_t>>& forward_row, const detail::PackedLines *packed,
+	               const std::vector<std::optional<detail::PackedKey>>& packed_keys) const
+	{
+		auto rows = m_puzzle.rows();
+		detail::CandidateFilter filter( m_puzzle.cols());
+		for( size_t key = 0; key < m_words.size(); ++key)
+		{
+			const auto& w = m_words[ key];
+			if( w.size() < 2)
+				continue;
+			const auto *packed_key = packed && packed_keys[ key] ? &*packed_keys[ key] : nullptr;
 
-			if( m.begin == m.end)
+			// Rows past a known forward match cannot hold a better one.
+			for( size_t i = first; i < last && i < forward_row[ key].load( std::memory_order_relaxed); ++i)
 			{
-				if( !m.word.empty() && tallies( m ) )
+				filter.filterRow( i > 0 ? m_puzzle[ i - 1].data() : nullptr, m_puzzle[ i].data(),
+				                  i + 1 < rows ? m_puzzle[ i + 1].data() : nullptr, w[ 0], w[ 1]);
+				for( int d = 1; d <= 8; ++d)
 				{
-					m_completed.insert( m );
-					m_found[ m.word ] = true;
+					auto direction = detail::Dir( d);
+					filter.forEach( direction, [ &]( size_t j)
+					{
+						Coord start{ static_cast<int>( i), static_cast<int>( j)};
+						if( packed_key ? packed->spells( *packed_key, start.x, start.y, direction)
+						               : spells( w, start, direction))
+							offer( best, key, placed( start, direction, w.size()));
+					});
+				}
+				if( best[ key].found() && !best[ key].reversed)
+				{
+					auto known = forward_row[ key].load();
+					while( i < known && !forward_row[ key].compare_exchange_weak( known, i))
+						;
+					break;
 				}
-				m.invalid = true;   // Mark the word so it can be removed.
 			}
 		}
 	}
 
-	/*
-	 * Confirm that the found word is matches.
-	 */
-	bool tallies( const ProgressTracker& tracker )
+	struct ProgressTrackerHash
 	{
-		Coord clone = tracker.start;
-		auto p_rows = static_cast<int>( m_puzzle.size()),
-			 p_cols = static_cast<int>( m_puzzle.front().size());
-		for( std::size_t i = 0; i < tracker.word.size(); ++i )
+		std::size_t operator()( const ProgressTracker& state ) const
 		{
-			if( clone.x >= p_rows || clone.y >= p_cols 
-                || m_puzzle[ static_cast<size_t>( clone.x)]
-                    [ static_cast<size_t>( clone.y)] != tracker.word[ i ] )
-				return false;
-			clone = m_dirlookup[ tracker.dmatch ]( clone );
+			return std::hash<std::string>{}( state.word );
 		}
-		return true;
+	};
+
+	// A key found reversed is spelled like another key found forwards; both are kept.
+	friend bool operator==( const ProgressTracker& l, const ProgressTracker& r )
+	{
+		return l.word == r.word && l.reversed == r.reversed;
 	}
 	
-	static detail::Dir newDir( Coord oldp, Coord newp )
+	/*
+	 * Move the trackers waiting for `letter` on to `pos`. Trackers of settled
+	 * words are dropped here, when their letter comes up, rather than looked
+	 * for in every list each time a word settles.
+	 */
+	void step( uint8_t letter, Coord pos )
 	{
-        detail::Dir new_dir = detail::Dir::NL;
-		int rw[] = {  0, 0, -1, 1,  1, -1, -1, 1 },
-		    cl[] = { -1, 1,  0, 0, -1,  1, -1, 1 };
-		for( int i = 0; i < 8; ++i )
+		// The list is rebuilt as it is walked: trackers started here go in
+		// front of the ones kept, in the order one list would have them.
+		auto i = m_waiting[ letter];
+		m_waiting[ letter] = NIL;
+		uint32_t kept = NIL, last_kept = NIL, first_new = NIL;
+		auto keep = [ & ]( uint32_t index )
+		{
+			( last_kept == NIL ? kept : m_trackers[ last_kept].next ) = index;
+			last_kept = index;
+		};
+		auto advance = [ & ]( const Tracker& tracker )
+		{
+			auto index = track( tracker );
+			if( first_new == NIL && m_waiting[ letter] == index )
+				first_new = index;
+		};
+
+		while( i != NIL )
 		{
-			Coord pos{ oldp.x + cl[ i], oldp.y + rw[ i] };
-			if( newp.x == pos.x && newp.y == pos.y )
+			// A copy, since tracking the next letter may move the pool.
+			auto current = i;
+			auto m       = m_trackers[ current];
+			i = m.next;
+			if( ( m_settled[ m.word] && !promising( m ) ) || passed( m, pos ) )
 			{
-				new_dir = detail::Dir(i+1);
-				break;
+				release( current );
+				continue ;
 			}
+
+			auto next = m;
+			next.pos  = pos;
+			auto last = m.begin == lastLetter( m );
+			if( m.start.x == NEG_INF )
+			{
+				// Every first letter starts a match of its own.
+				next.start = pos;
+				if( last )
+					reach( next );
+				else
+				{
+					++next.begin;
+					advance( next );
+				}
+				keep( current );
+				continue ;
+			}
+
+			next.dmatch = newDir( m.pos, pos );
+			if( next.dmatch == detail::Dir::NL || ( m.dmatch != detail::Dir::NL && next.dmatch != m.dmatch ) )
+			{
+				keep( current );
+				continue ;
+			}
+			if( last )
+				reach( next );
+			else
+			{
+				++next.begin;
+				advance( next );
+			}
+			// Only the second letter may follow in more than one direction.
+			if( m.dmatch == detail::Dir::NL )
+				keep( current );
+			else
+				release( current );
 		}
-		return new_dir;
+
+		if( last_kept != NIL )
+			m_trackers[ last_kept].next = NIL;
+		( first_new == NIL ? m_waiting[ letter] : m_trackers[ first_new].next ) = kept;
 	}
-	
-	void preprocess()
+
+	/*
+	 * Mark `word` found; its trackers are stale from now on.
+	 */
+	void settle( uint32_t word )
 	{
-		for( auto& w : m_words )
-		{
-			std::transform( w.cbegin(), w.cend(), w.begin(), toupper );
-			m_tracker[ w.front() ].emplace_front( ProgressTracker{ w, w.size() - 1});
-		}
+		if( m_settled[ word] )
+			return;
+		m_settled[ word] = true;
+		m_stale += m_live[ word];
 	}
 
-	std::vector<std::string> m_rev_words;
-	std::unordered_map<char, std::forward_list<ProgressTracker>> m_tracker;
-	std::vector<std::string> m_puzzle, m_words;
-	std::unordered_set<ProgressTracker, ProgressTrackerHash> m_completed;
-	std::unordered_map<std::string, bool> m_found;
-	static inline std::unordered_map<detail::Dir, std::function<Coord(Coord)>> m_dirlookup =  {
-        { detail::Dir::NL, []( auto     ) -> Coord { return { NEG_INF, NEG_INF }; } },
-        { detail::Dir::NT, []( auto pos ) -> Coord { return { pos.x-1, pos.y   }; } },
-        { detail::Dir::ST, []( auto pos ) -> Coord { return { pos.x+1, pos.y   }; } },
-        { detail::Dir::ET, []( auto pos ) -> Coord { return { pos.x,   pos.y+1 }; } },
-        { detail::Dir::WT, []( auto pos ) -> Coord { return { pos.x,   pos.y-1 }; } },
-        { detail::Dir::NE, []( auto pos ) -> Coord { return { pos.x-1, pos.y+1 }; } },
-        { detail::Dir::SE, []( auto pos ) -> Coord { return { pos.x+1, pos.y+1 }; } },
-        { detail::Dir::NW, []( auto pos ) -> Coord { return { pos.x-1, pos.y-1 }; } },
-        { detail::Dir::SW, []( auto pos ) -> Coord { return { pos.x+1, pos.y-1 }; } }
-    };
-};
+	/*
+	 * Record that `tracker` has read its last letter. A single letter has no
+	 * direction; it is placed along S, like firstCell() places it.
+	 */
+	void reach( const Tracker& tracker )
+	{
+		Placement found{ tracker.start, tracker.dmatch == detail::Dir::NL ? detail::Dir::ST : tracker.dmatch, false };
+		if( found.preferredTo( m_best[ tracker.word] ) )
+			m_best[ tracker.word] = found;
+		settle( tracker.word );
+		if( !m_backward[ tracker.word] && m_backward[ m_mirror[ tracker.word]] )
+			settle( m_mirror[ tracker.word] );
+	}
 
+	/*
+	 * Whether `tracker` may still reach a match its word prefers to the one
+	 * it has: only one that started earlier, or at the same cell in a lower
+	 * direction, can. A word that is only a reversal wants none once the key
+	 * is found forwards.
+	 */
+	bool promising( const Tracker& tracker ) const
+	{
+		if( m_backward[ tracker.word] && m_best[ m_mirror[ tracker.word]].found() )
+			return false;
+		const auto& best = m_best[ tracker.word];
+		if( !best.found() )
+			return true;
+		return tracker.start.x != NEG_INF
+		       && std::make_tuple( tracker.start.x, tracker.start.y, static_cast<int>( tracker.dmatch ) )
+		          < std::make_tuple( best.start.x, best.start.y, static_cast<int>( best.dmatch ) );
+	}
 
-class PuzzleFileReader
-{
-public:
-	explicit PuzzleFileReader( std::istream& strm )
-	: m_istrm( strm )
+	/*
+	 * Whether the sweep at `pos` has gone past every cell `tracker` could take
+	 * its next letter from: the one after it along its direction, or any of
+	 * the neighbours that follow it in scan order while it has none.
+	 */
+	static bool passed( const Tracker& tracker, Coord pos )
 	{
-		ignoreBOM();
+		if( tracker.start.x == NEG_INF )
+			return false;
+		auto last = tracker.dmatch == detail::Dir::NL ? Coord{ tracker.pos.x + 1, tracker.pos.y + 1 }
+		                                             : next( tracker.dmatch, tracker.pos );
+		return std::make_pair( pos.x, pos.y ) > std::make_pair( last.x, last.y );
 	}
-	PuzzleFileReader operator=( const PuzzleFileReader& ) = delete;
-	PuzzleFileReader( const PuzzleFileReader& )           = delete;
-	auto getPuzzles()
+
+	/*
+	 * Add `tracker` to the front of the list waiting for its next letter,
+	 * reusing a node swept earlier when there is one.
+	 */
+	uint32_t track( Tracker tracker )
 	{
-		if( !has_processed)
+		auto letter = static_cast<uint8_t>( m_interned[ m_spans[ tracker.word].first + tracker.begin] );
+		auto index  = m_free;
+		if( index != NIL )
+		{
+			m_free             = m_trackers[ index].next;
+			m_trackers[ index] = tracker;
+		}
+		else
 		{
-			parseFile();
-			has_processed = true;
+			index = static_cast<uint32_t>( m_trackers.size() );
+			m_trackers.push_back( tracker );
 		}
+		m_trackers[ index].next = m_waiting[ letter];
+		m_waiting[ letter]      = index;
+		m_listed[ letter]       = true;
+		++m_live[ tracker.word];
+		++m_tracking;
+		m_stale += m_settled[ tracker.word];
+		detail::Stats::count( detail::Stats::TRACKERS_CREATED);
+		return index;
+	}
 
-		return m_puzzles;
+	/*
+	 * Return a tracker, already unlinked from its list, to the pool.
+	 */
+	void release( uint32_t index )
+	{
+		auto& tracker = m_trackers[ index];
+		--m_live[ tracker.word];
+		--m_tracking;
+		m_stale -= m_settled[ tracker.word];
+		tracker.next = m_free;
+		m_free       = index;
+		detail::Stats::count( detail::Stats::TRACKERS_DISCARDED);
 	}
-private:
-	
-	void ignoreBOM()
+
+	/*
+	 * Drop every tracker at once; the pool keeps its memory for the next sweep.
+	 */
+	void releaseTrackers()
 	{
-		if( m_istrm.peek() == 0xEF )
-		{
-			char dummy[ 4];
-			m_istrm.get( dummy, 4 );
-		}
+		m_trackers.clear();
+		m_free     = NIL;
+		m_tracking = m_stale = m_stale_kept = 0;
+		m_waiting.fill( NIL );
+		m_listed.fill( false );
 	}
-	
-	void parseFile()
+
+	std::string_view interned( uint32_t id ) const
 	{
-        constexpr auto PUZZLE = std::string_view{ "puzzle:"};
-        constexpr auto KEY    = std::string_view{ "key:"};
-		auto mode = ParseMode::NILL;
-		std::vector<std::string> cur[ 2];
-		while( m_istrm )
-		{
-			auto w = nextWord();
-			if( w.empty() )
-				continue;
-			if( mode != ParseMode::NILL && w.back() != ':' )
-				cur[ static_cast<int>(mode)-1 ].push_back( shaped( w ) );
-			else
-			{
-				if( mode != ParseMode::NILL && !cur[ 0].empty() && !cur[ 1].empty() )
-				{
-					m_puzzles.push_back( {} );
-					m_puzzles.back().puzzle = cur[ 0];
-					m_puzzles.back().keys   = cur[ 1];
-					cur[ 0].clear(); cur[ 1].clear();
-				}
-				
-                std::transform( w.begin(), w.end(), w.begin(), ::tolower);
-				if( w == PUZZLE )
-					mode = ParseMode::PUZZLE;
-				else if( w == KEY)
-					mode = ParseMode::KEY;
-				else
-					mode = ParseMode::NILL;
-			}
-		}
-		
+		return { m_interned.data() + m_spans[ id].first, m_spans[ id].second };
 	}
-	
-	static std::string shaped( const std::string& given )
+
+	size_t lastLetter( const Tracker& tracker ) const
 	{
-		std::string new_s;
-		std::copy_if( given.cbegin(), given.cend(),
-		              std::back_inserter( new_s), isalpha );
-		return new_s;
+		return m_spans[ tracker.word].second - size_t{ 1 };
 	}
-	
-	std::string nextWord()
+
+	bool spells( std::string_view word, Coord start, detail::Dir direction ) const
 	{
-		std::string word;
-		std::decay_t<decltype( m_istrm)>::char_type c;
-		
-		while( m_istrm.get( c ) && c != ' ' && c != '\n' )
-			word += c;
-		return word;
+		return detail::withDir( direction, [ & ]( auto d ) { return spellsAlong<d()>( word, start ); } );
 	}
 
-	enum class ParseMode
+	/*
+	 * spells() for a direction fixed at compile time: both ends are checked
+	 * against the grid once, then the letters are compared a constant number
+	 * of bytes apart.
+	 */
+	template<detail::Dir D>
+	bool spellsAlong( std::string_view word, Coord start ) const
 	{
-		NILL,
-		PUZZLE,
-		KEY
-	};
-	struct PuzzleImage
+		constexpr int dx = detail::DIR_DX[ static_cast<int>( D )],
+		              dy = detail::DIR_DY[ static_cast<int>( D )];
+		auto span   = static_cast<int>( word.size() ) - 1;
+		auto p_rows = static_cast<int>( m_puzzle.rows() ),
+		     p_cols = static_cast<int>( m_puzzle.cols() );
+		// NL stays put, so nothing longer than a letter can be spelled along it.
+		if( span < 0 || ( D == detail::Dir::NL && span > 0 )
+		    || start.x < 0 || start.y < 0 || start.x >= p_rows || start.y >= p_cols )
+			return span < 0;
+		auto end_x = start.x + span * dx, end_y = start.y + span * dy;
+		if( end_x < 0 || end_y < 0 || end_x >= p_rows || end_y >= p_cols )
+			return false;
+
+		const auto stride = static_cast<long>( m_puzzle.stride() );
+		const auto *cell  = m_puzzle.data() + start.x * stride + start.y;
+		for( long i = 0; i <= span; ++i )
+			if( cell[ i * ( dx * stride + dy )] != word[ static_cast<size_t>( i )] )
+				return false;
+		return true;
+	}
+	
+	static detail::Dir newDir( Coord oldp, Coord newp )
 	{
-		std::vector<std::string> puzzle,
-		                         keys;
-	};
-	std::vector<PuzzleImage> m_puzzles;
-	std::istream& m_istrm;
-	bool has_processed{};
+		return detail::dirOf( newp.x - oldp.x, newp.y - oldp.y );
+	}
+	
+	/*
+	 * Upper-case the keys and intern them, and their reversals, once each
+	 * into one NUL separated table; trackers name their words by id, so the
+	 * sweep neither copies nor hashes a string. Equal words share an id.
+	 */
+	void preprocess()
+	{
+		detail::Stats::Timer timer( detail::Stats::PREPROCESS);
+		std::unordered_map<std::string, uint32_t> ids;
+		auto intern = [ & ]( const std::string& word )
+		{
+			auto [ at, added ] = ids.try_emplace( word, static_cast<uint32_t>( m_spans.size() ) );
+			if( added )
+			{
+				m_spans.emplace_back( static_cast<uint32_t>( m_interned.size() ), static_cast<uint32_t>( word.size() ) );
+				m_interned.append( word ).push_back( '\0' );
+			}
+			return at->second;
+		};
+		for( auto& w : m_words )
+		{
+			// Wildcards only mean anything to approximate searches; exact ones skip them.
+			w.erase( std::remove( w.begin(), w.end(), '?' ), w.end() );
+			// Ids past ASCII are letters the reader has upper-cased already.
+			std::transform( w.cbegin(), w.cend(), w.begin(), []( char c )
+			{
+				return c >= 'a' && c <= 'z' ? static_cast<char>( c - 'a' + 'A' ) : c;
+			} );
+			m_key_ids.push_back( intern( w ) );
+		}
+		for( const auto& w : m_words )
+			m_reversed_ids.push_back( intern( detail::util::reversed( w ) ) );
+
+		m_mirror.resize( m_spans.size() );
+		m_backward.assign( m_spans.size(), true );
+		for( size_t k = 0; k < m_words.size(); ++k )
+		{
+			m_mirror[ m_key_ids[ k]]      = m_reversed_ids[ k];
+			m_mirror[ m_reversed_ids[ k]] = m_key_ids[ k];
+		}
+		for( auto id : m_key_ids )
+			m_backward[ id] = false;
+		m_trackers.reserve( 8 * m_words.size() );
+	}
+
+	std::string m_interned;                                   // Words of the trackers, NUL terminated.
+	std::vector<std::pair<uint32_t, uint32_t>> m_spans;       // Offset and size of each interned word.
+	std::vector<uint32_t> m_key_ids, m_reversed_ids;          // Interned ids of each key and its reversal.
+	std::vector<uint32_t> m_mirror;                           // Id of each interned word's reversal.
+	std::vector<bool> m_backward;                             // Interned words that are no key, only a reversal.
+	std::vector<Tracker> m_trackers;                          // Pool of the sweep.
+	uint32_t m_free{ NIL };                                   // Swept trackers, linked through `next`.
+	std::array<uint32_t, 256> m_waiting;                      // Trackers waiting for each letter.
+	std::array<bool, 256> m_listed;                           // Letters trackers have waited for in the sweep.
+	std::vector<bool> m_settled;                              // Interned words whose trackers are done.
+	std::vector<uint32_t> m_live;                             // Trackers in the lists for each interned word.
+	size_t m_tracking{}, m_stale{};                           // Trackers in the lists, and those of settled words.
+	size_t m_stale_kept{};                                    // Trackers of settled words the last sweep kept.
+	std::vector<Placement> m_best;                            // Best match of each interned word in the sweep.
+	detail::PuzzleGrid m_puzzle;
+	std::vector<std::string> m_words;
+	std::unordered_set<ProgressTracker, ProgressTrackerHash> m_completed;
+	std::unordered_map<std::string, bool> m_found;
+	Engine m_engine{ Engine::Tracker };
+	detail::ThreadPool *m_pool{ nullptr };
+	detail::SolutionCache *m_cache{ nullptr };
+	detail::KnownSolution m_known;
+	// Rough number of cells in one tile, enough to outweigh handing it to another thread.
+	static constexpr size_t TILE_CELLS = 1 << 14;
+	// Directions that read along scan order, and the ones that read against it.
+	static constexpr detail::Dir FORWARD[]  = { detail::Dir::ST, detail::Dir::ET, detail::Dir::SW, detail::Dir::SE };
+	static constexpr detail::Dir BACKWARD[] = { detail::Dir::NT, detail::Dir::WT, detail::Dir::NE, detail::Dir::NW };
 };
 
 #endif
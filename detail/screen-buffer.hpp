@@ -0,0 +1,259 @@
+#ifndef PUZZLER_SCREEN_BUFFER_HPP
+#define PUZZLER_SCREEN_BUFFER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "stats.hpp"
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * Model of the terminal screen. Drawing goes to a back buffer; present()
+ * compares it with the front buffer, which holds what the terminal shows,
+ * and sends only the cells that changed as a single write. Cursor moves are
+ * relative when that is shorter, and colour codes are only sent when the
+ * style changes from one written cell to the next.
+ */
+class ScreenBuffer
+{
+public:
+	// Cell styles: a foreground colour from 30 to 37 (0 keeps the default),
+	// optionally combined with these attributes.
+	enum Attribute : uint16_t
+	{
+		BOLD      = 1 << 8,
+		UNDERLINE = 1 << 9
+	};
+
+	/*
+	 * Match the terminal size. A new size, like the first call, makes the
+	 * next frame clear the screen and redraw every cell.
+	 */
+	void resize( size_t rows, size_t cols)
+	{
+		if( rows == m_rows && cols == m_cols)
+			return;
+		m_rows = rows;
+		m_cols = cols;
+		m_back.assign( rows * cols, Cell{});
+		invalidate();
+	}
+
+	/*
+	 * Forget what the terminal shows, after something else has drawn on it.
+	 */
+	void invalidate()
+	{
+		m_front.assign( m_rows * m_cols, Cell{});
+		m_cleared = false;
+	}
+
+	/*
+	 * Blank the back buffer, to draw a frame from scratch.
+	 */
+	void clear()
+	{
+		std::fill( m_back.begin(), m_back.end(), Cell{});
+	}
+
+	/*
+	 * Draw UTF-8 `text` from ( row, col) on, one code point per cell; whatever
+	 * falls outside the screen is dropped.
+	 */
+	void put( size_t row, size_t col, std::string_view text, uint16_t style = 0)
+	{
+		for( size_t i = 0; i < text.size(); ++col)
+		{
+			auto size = std::min( static_cast<size_t>( util::byteCount( static_cast<uint8_t>( text[ i]))),
+			                      std::min<size_t>( text.size() - i, 4));
+			if( row < m_rows && col < m_cols)
+			{
+				auto& cell = m_back[ row * m_cols + col];
+				cell.glyph.fill( 0);
+				std::memcpy( cell.glyph.data(), text.data() + i, size);
+				cell.style = style;
+			}
+			i += size;
+		}
+	}
+
+	/*
+	 * Leave the cursor at ( row, col) once the next frame has been drawn.
+	 */
+	void park( size_t row, size_t col)
+	{
+		m_park_row = row;
+		m_park_col = col;
+		m_parked   = false;
+	}
+
+	/*
+	 * Send the difference between the back and the front buffer to `strm`.
+	 * Frames that change more than one cell are wrapped in a synchronized
+	 * update, so the terminal shows them all at once; a single cell cannot
+	 * tear. Nothing is written when nothing changed.
+	 */
+	void present( std::ostream& strm)
+	{
+		Stats::Timer timer( Stats::FRAME);
+		m_frame.clear();
+		size_t changed = 0;
+		if( !m_cleared)
+		{
+			// Start from a known state; the front buffer is blank to match.
+			m_frame += "\x1B[0m\x1B[2J";
+			m_style   = 0;
+			m_row     = m_col = UNKNOWN;
+			m_cleared = true;
+			changed   = m_back.size();
+		}
+
+		for( size_t r = 0; r < m_rows; ++r)
+		{
+			for( size_t c = 0; c < m_cols; ++c)
+			{
+				auto& back  = m_back[ r * m_cols + c];
+				auto& front = m_front[ r * m_cols + c];
+				if( back == front)
+					continue;
+				moveTo( r, c);
+				draw( back);
+				front = back;
+				++changed;
+			}
+		}
+
+		if( !m_parked && m_park_row < m_rows)
+		{
+			moveTo( m_park_row, m_park_col);
+			m_parked = true;
+		}
+		if( m_frame.empty())
+			return;
+
+		if( changed > 1)
+			m_frame = "\x1B[?2026h" + m_frame + "\x1B[?2026l";
+		strm.write( m_frame.data(), static_cast<std::streamsize>( m_frame.size()));
+		strm.flush();
+	}
+
+	size_t rows() const
+	{
+		return m_rows;
+	}
+
+	size_t cols() const
+	{
+		return m_cols;
+	}
+
+private:
+	static constexpr size_t UNKNOWN = SIZE_MAX;
+
+	struct Cell
+	{
+		std::array<char, 4> glyph{ ' ', 0, 0, 0};
+		uint16_t style{};
+
+		bool operator==( const Cell& other) const
+		{
+			return glyph == other.glyph && style == other.style;
+		}
+
+		bool operator!=( const Cell& other) const
+		{
+			return !( *this == other);
+		}
+	};
+
+	void draw( const Cell& cell)
+	{
+		if( cell.style != m_style)
+		{
+			// Only what differs is sent; switching an attribute off takes a full reset.
+			std::string codes;
+			auto current = m_style;
+			if( current & ~cell.style & ( BOLD | UNDERLINE))
+			{
+				codes   = ";0";
+				current = 0;
+			}
+			if( cell.style & ~current & BOLD)
+				codes += ";1";
+			if( cell.style & ~current & UNDERLINE)
+				codes += ";4";
+			if( auto colour = cell.style & 0xFF; colour != ( current & 0xFF))
+				codes += colour ? ';' + std::to_string( colour) : std::string( ";39");
+			m_frame += "\x1B[" + codes.substr( 1) + 'm';
+			m_style = cell.style;
+		}
+		m_frame.append( cell.glyph.data(), strnlen( cell.glyph.data(), cell.glyph.size()));
+		// Writing the last column leaves the cursor in a terminal specific place.
+		m_col = m_col + 1 < m_cols ? m_col + 1 : UNKNOWN;
+	}
+
+	/*
+	 * Move the cursor with the shortest of an absolute move, relative moves
+	 * and, for a short hop along a row, rewriting the cells in between.
+	 */
+	void moveTo( size_t row, size_t col)
+	{
+		if( row == m_row && col == m_col)
+			return;
+
+		if( row == m_row && m_col != UNKNOWN && col > m_col && col - m_col <= 4)
+		{
+			bool same_style = true;
+			for( auto c = m_col; same_style && c < col; ++c)
+				same_style = m_front[ row * m_cols + c].style == m_style;
+			if( same_style)
+			{
+				for( auto c = m_col; c < col; ++c)
+					draw( m_front[ row * m_cols + c]);
+				return;
+			}
+		}
+
+		auto absolute = "\x1B[" + std::to_string( row + 1) + ";" + std::to_string( col + 1) + "H";
+		if( m_row != UNKNOWN && m_col != UNKNOWN)
+		{
+			std::string relative;
+			if( row > m_row)
+				relative += row - m_row == 1 ? "\x1B[B" : "\x1B[" + std::to_string( row - m_row) + "B";
+			else if( row < m_row)
+				relative += m_row - row == 1 ? "\x1B[A" : "\x1B[" + std::to_string( m_row - row) + "A";
+			if( col == 0 && m_col != 0)
+				relative += '\r';
+			else if( col > m_col)
+				relative += col - m_col == 1 ? "\x1B[C" : "\x1B[" + std::to_string( col - m_col) + "C";
+			else if( col < m_col)
+				relative += m_col - col == 1 ? "\x1B[D" : "\x1B[" + std::to_string( m_col - col) + "D";
+			if( relative.size() < absolute.size())
+				absolute = std::move( relative);
+		}
+		m_frame += absolute;
+		m_row = row;
+		m_col = col;
+	}
+
+	size_t m_rows{}, m_cols{};
+	std::vector<Cell> m_back, m_front;
+	std::string m_frame;
+	uint16_t m_style{};
+	size_t m_row{ UNKNOWN}, m_col{ UNKNOWN};
+	size_t m_park_row{ UNKNOWN}, m_park_col{};
+	bool m_cleared{ false}, m_parked{ true};
+};
+
+}
+
+#endif //PUZZLER_SCREEN_BUFFER_HPP
@@ -0,0 +1,130 @@
+#ifndef PUZZLER_SHA256_HPP
+#define PUZZLER_SHA256_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace detail
+{
+
+/*
+ * SHA-256 (FIPS 180-4), fed incrementally.
+ */
+class Sha256
+{
+public:
+	using Digest = std::array<uint8_t, 32>;
+
+	Sha256& update( const void *data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t *>( data);
+		m_length += size;
+		while( size > 0)
+		{
+			auto take = std::min( size, m_block.size() - m_used);
+			std::memcpy( m_block.data() + m_used, bytes, take);
+			m_used += take, bytes += take, size -= take;
+			if( m_used == m_block.size())
+			{
+				compress();
+				m_used = 0;
+			}
+		}
+		return *this;
+	}
+
+	Sha256& update( std::string_view text)
+	{
+		return update( text.data(), text.size());
+	}
+
+	Digest digest()
+	{
+		auto bits = m_length * 8;
+		uint8_t pad = 0x80;
+		update( &pad, 1);
+		pad = 0;
+		while( m_used != 56)
+			update( &pad, 1);
+		uint8_t length[ 8];
+		for( int i = 0; i < 8; ++i)
+			length[ i] = static_cast<uint8_t>( bits >> ( 56 - 8 * i));
+		update( length, sizeof length);
+
+		Digest out;
+		for( size_t i = 0; i < 8; ++i)
+			for( size_t k = 0; k < 4; ++k)
+				out[ 4 * i + k] = static_cast<uint8_t>( m_state[ i] >> ( 24 - 8 * k));
+		return out;
+	}
+
+	static std::string hex( const Digest& digest)
+	{
+		constexpr char DIGITS[] = "0123456789abcdef";
+		std::string text;
+		for( auto byte : digest)
+			text += { DIGITS[ byte >> 4], DIGITS[ byte & 0xF]};
+		return text;
+	}
+
+private:
+	static uint32_t rotr( uint32_t x, int n)
+	{
+		return x >> n | x << ( 32 - n);
+	}
+
+	void compress()
+	{
+		static constexpr uint32_t K[ 64] = {
+			0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+			0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+			0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+			0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+			0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+			0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+			0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+			0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+		};
+
+		uint32_t w[ 64];
+		for( size_t i = 0; i < 16; ++i)
+			w[ i] = uint32_t{ m_block[ 4 * i]} << 24 | uint32_t{ m_block[ 4 * i + 1]} << 16
+			        | uint32_t{ m_block[ 4 * i + 2]} << 8 | m_block[ 4 * i + 3];
+		for( size_t i = 16; i < 64; ++i)
+		{
+			auto s0 = rotr( w[ i - 15], 7) ^ rotr( w[ i - 15], 18) ^ ( w[ i - 15] >> 3),
+			     s1 = rotr( w[ i - 2], 17) ^ rotr( w[ i - 2], 19) ^ ( w[ i - 2] >> 10);
+			w[ i] = w[ i - 16] + s0 + w[ i - 7] + s1;
+		}
+
+		auto s = m_state;
+		for( size_t i = 0; i < 64; ++i)
+		{
+			auto t1 = s[ 7] + ( rotr( s[ 4], 6) ^ rotr( s[ 4], 11) ^ rotr( s[ 4], 25))
+			          + ( ( s[ 4] & s[ 5]) ^ ( ~s[ 4] & s[ 6])) + K[ i] + w[ i];
+			auto t2 = ( rotr( s[ 0], 2) ^ rotr( s[ 0], 13) ^ rotr( s[ 0], 22))
+			          + ( ( s[ 0] & s[ 1]) ^ ( s[ 0] & s[ 2]) ^ ( s[ 1] & s[ 2]));
+			for( size_t k = 7; k > 0; --k)
+				s[ k] = s[ k - 1];
+			s[ 4] += t1;
+			s[ 0] = t1 + t2;
+		}
+		for( size_t i = 0; i < 8; ++i)
+			m_state[ i] += s[ i];
+	}
+
+	std::array<uint32_t, 8> m_state{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	                                 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+	std::array<uint8_t, 64> m_block{};
+	size_t m_used{};
+	uint64_t m_length{};
+};
+
+}
+
+#endif //PUZZLER_SHA256_HPP
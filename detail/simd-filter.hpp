@@ -0,0 +1,137 @@
+#ifndef PUZZLER_SIMD_FILTER_HPP
+#define PUZZLER_SIMD_FILTER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "utility.hpp"
+
+#if defined( __AVX2__)
+#   include <immintrin.h>
+#elif defined( __SSE2__)
+#   include <emmintrin.h>
+#endif
+
+namespace detail
+{
+
+/*
+ * Rules out start cells for a key before it is verified in full. A cell stays
+ * a candidate for a direction only if it holds the key's first letter and its
+ * neighbour in that direction holds the second one. Rows are compared a vector
+ * at a time; the grid edges and the row tails fall back to scalar compares.
+ */
+class CandidateFilter
+{
+public:
+#if defined( __AVX2__)
+	static constexpr size_t WIDTH = 32;
+#elif defined( __SSE2__)
+	static constexpr size_t WIDTH = 16;
+#else
+	static constexpr size_t WIDTH = 0;
+#endif
+	explicit CandidateFilter( size_t cols)
+		: m_cols( cols), m_words(( cols + 63) / 64)
+	{
+		for( auto& bitmap : m_bitmaps)
+			bitmap.resize( m_words);
+	}
+
+	/*
+	 * Fill the per-direction candidate bitmaps of one row. `above` and `below`
+	 * are the neighbouring rows, or null at the grid's edges.
+	 */
+	void filterRow( const char *above, const char *row, const char *below, char first, char second)
+	{
+		for( auto& bitmap : m_bitmaps)
+			std::fill( bitmap.begin(), bitmap.end(), 0);
+
+		const char *neighbours[] = { above, below, row, row, above, below, above, below };
+		size_t j = 0;
+		if constexpr( WIDTH > 0)
+		{
+			// The first chunk starts at column 1 so that every diagonal load stays inside the row.
+			for( j = 1; j + WIDTH + 1 <= m_cols; j += WIDTH)
+			{
+				auto firsts = matchMask( row + j, first);
+				if( firsts == 0)
+					continue;
+
+				for( size_t d = 0; d < 8; ++d)
+				{
+					if( neighbours[ d] == nullptr)
+						continue;
+					auto seconds = matchMask( neighbours[ d] + j + DIR_DY[ d + 1], second) & firsts;
+					if( seconds != 0)
+						setBits( m_bitmaps[ d], j, seconds);
+				}
+			}
+			filterScalar( neighbours, row, first, second, 0, std::min<size_t>( 1, m_cols));
+		}
+		filterScalar( neighbours, row, first, second, j, m_cols);
+	}
+
+	/*
+	 * Call visit( column) for every candidate of the given direction.
+	 */
+	template<typename Visitor>
+	void forEach( Dir direction, Visitor&& visit) const
+	{
+		auto& bitmap = m_bitmaps[ static_cast<size_t>( direction) - 1];
+		for( size_t w = 0; w < m_words; ++w)
+			for( auto bits = bitmap[ w]; bits != 0; bits &= bits - 1)
+				visit( w * 64 + static_cast<size_t>( __builtin_ctzll( bits)));
+	}
+
+private:
+	static uint64_t matchMask( const char *p, char c)
+	{
+#if defined( __AVX2__)
+		auto chunk = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( p));
+		return static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( chunk, _mm256_set1_epi8( c))));
+#elif defined( __SSE2__)
+		auto chunk = _mm_loadu_si128( reinterpret_cast<const __m128i *>( p));
+		return static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( chunk, _mm_set1_epi8( c))));
+#else
+		( void)p, ( void)c;
+		return 0;
+#endif
+	}
+
+	static void setBits( std::vector<uint64_t>& bitmap, size_t column, uint64_t bits)
+	{
+		auto word = column / 64, shift = column % 64;
+		bitmap[ word] |= bits << shift;
+		if( shift != 0 && word + 1 < bitmap.size())
+			bitmap[ word + 1] |= bits >> ( 64 - shift);
+	}
+
+	void filterScalar( const char *const *neighbours, const char *row, char first, char second,
+	                   size_t from, size_t to)
+	{
+		for( size_t j = from; j < to; ++j)
+		{
+			if( row[ j] != first)
+				continue;
+
+			for( size_t d = 0; d < 8; ++d)
+			{
+				auto y = static_cast<long>( j) + DIR_DY[ d + 1];
+				if( neighbours[ d] == nullptr || y < 0 || y >= static_cast<long>( m_cols))
+					continue;
+				if( neighbours[ d][ y] == second)
+					m_bitmaps[ d][ j / 64] |= uint64_t{ 1} << ( j % 64);
+			}
+		}
+	}
+
+	size_t m_cols, m_words;
+	std::array<std::vector<uint64_t>, 8> m_bitmaps;
+};
+
+}
+
+#endif //PUZZLER_SIMD_FILTER_HPP
@@ -0,0 +1,147 @@
+#ifndef PUZZLER_SIMULATOR_CACHE_HPP
+#define PUZZLER_SIMULATOR_CACHE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include "puzzle-simulator.hpp"
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * Owns the simulator of every visited puzzle. While one puzzle is shown, a
+ * worker thread builds, and so solves, the puzzles the user can reach with a
+ * single key press, so moving to them does not stall on the solver.
+ */
+class SimulatorCache
+{
+public:
+	using Factory   = std::function<std::unique_ptr<TerminalPuzzleSimulator>( size_t index)>;
+	// Index reached from `index` by moving forward or backward, as main() navigates.
+	using Navigator = std::function<size_t( size_t index, bool forward)>;
+
+	SimulatorCache( Factory factory, Navigator navigator)
+		: m_factory( std::move( factory)), m_navigator( std::move( navigator))
+	{
+		m_worker = std::thread( [ this] { prefetch(); });
+	}
+
+	SimulatorCache( const SimulatorCache&)            = delete;
+	SimulatorCache& operator=( const SimulatorCache&) = delete;
+
+	~SimulatorCache()
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_mutex);
+			m_stopping = true;
+		}
+		m_refocused.notify_one();
+		m_worker.join();
+	}
+
+	/*
+	 * Simulator for puzzle `index`, built here unless the worker already has
+	 * it or is in the middle of building it.
+	 */
+	TerminalPuzzleSimulator *acquire( size_t index)
+	{
+		std::unique_lock<std::mutex> lock( m_mutex);
+		auto& slot = slotAt( index);
+		if( slot.state == State::Building)
+			m_built.wait( lock, [ &slot] { return slot.state == State::Ready; });
+		else if( slot.state == State::Empty)
+			build( lock, slot, index);
+		return slot.sim.get();
+	}
+
+	/*
+	 * Start preparing the neighbours of puzzle `index`; any older request
+	 * that has not been started yet is dropped.
+	 */
+	void around( size_t index)
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_mutex);
+			m_focus = index;
+		}
+		m_refocused.notify_one();
+	}
+
+private:
+	enum class State
+	{
+		Empty,
+		Building,
+		Ready
+	};
+
+	struct Slot
+	{
+		State state{ State::Empty};
+		std::unique_ptr<TerminalPuzzleSimulator> sim;
+	};
+
+	Slot& slotAt( size_t index)
+	{
+		// A deque keeps existing slots in place when it grows.
+		if( m_slots.size() <= index)
+			m_slots.resize( index + 1);
+		return m_slots[ index];
+	}
+
+	void build( std::unique_lock<std::mutex>& lock, Slot& slot, size_t index)
+	{
+		slot.state = State::Building;
+		lock.unlock();
+		auto sim = m_factory( index);
+		lock.lock();
+		slot.sim   = std::move( sim);
+		slot.state = State::Ready;
+		m_built.notify_all();
+	}
+
+	void prefetch()
+	{
+		util::blockSignals();
+		std::unique_lock<std::mutex> lock( m_mutex);
+		for( ;;)
+		{
+			m_refocused.wait( lock, [ this] { return m_stopping || m_focus.has_value(); });
+			if( m_stopping)
+				return;
+			auto focus = *m_focus;
+			m_focus.reset();
+			for( auto forward : { true, false})
+			{
+				// Finding a neighbour may wait for the parser, so it is done unlocked.
+				lock.unlock();
+				auto target = m_navigator( focus, forward);
+				lock.lock();
+				if( m_stopping || m_focus)
+					break;
+				if( auto& slot = slotAt( target); slot.state == State::Empty)
+					build( lock, slot, target);
+			}
+		}
+	}
+
+	Factory m_factory;
+	Navigator m_navigator;
+	std::deque<Slot> m_slots;
+	std::optional<size_t> m_focus;
+	bool m_stopping{ false};
+	std::mutex m_mutex;
+	std::condition_variable m_built, m_refocused;
+	std::thread m_worker;
+};
+
+}
+
+#endif //PUZZLER_SIMULATOR_CACHE_HPP
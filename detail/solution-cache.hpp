@@ -0,0 +1,244 @@
+#ifndef PUZZLER_SOLUTION_CACHE_HPP
+#define PUZZLER_SOLUTION_CACHE_HPP
+
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "sha256.hpp"
+
+namespace detail
+{
+
+/*
+ * Solutions kept on disk under a SHA-256 of what was solved, so that a
+ * puzzle seen before, in this run or an earlier one, costs a file read
+ * instead of a solve. Every entry is a file of its own, written under a
+ * temporary name and renamed into place: concurrent processes only ever see
+ * complete entries and need no lock to read them. A hit refreshes the
+ * entry's mtime, and once the cache outgrows its limit the least recently
+ * used entries are removed by whichever process holds an flock() on it.
+ */
+class SolutionCache
+{
+public:
+	// One key's match, as PuzzleSolver reports it.
+	struct Match
+	{
+		uint32_t key;       // Index into the keys.
+		int32_t row, col;
+		uint8_t direction, reversed;
+		uint16_t unused{};  // Keeps the layout free of padding, for archives that store it as is.
+	};
+
+	SolutionCache( std::string directory, uint64_t max_bytes)
+		: m_directory( std::move( directory)), m_max_bytes( max_bytes)
+	{
+		while( m_directory.size() > 1 && m_directory.back() == '/')
+			m_directory.pop_back();
+	}
+
+	/*
+	 * $XDG_CACHE_HOME/puzzler, falling back to ~/.cache/puzzler.
+	 */
+	static std::string defaultDirectory()
+	{
+		if( auto xdg = getenv( "XDG_CACHE_HOME"); xdg && *xdg)
+			return std::string( xdg) + "/puzzler";
+		auto home = getenv( "HOME");
+		return std::string( home && *home ? home : ".") + "/.cache/puzzler";
+	}
+
+	/*
+	 * Create `path` and whatever directories above it are missing.
+	 */
+	static void makeDirectories( const std::string& path)
+	{
+		for( size_t slash = 1; slash != std::string::npos; slash = path.find( '/', slash + 1))
+			mkdir( path.substr( 0, slash).c_str(), 0755);
+		mkdir( path.c_str(), 0755);
+	}
+
+	std::optional<std::vector<Match>> lookup( const Sha256::Digest& key) const
+	{
+		auto path = entryPath( Sha256::hex( key));
+		int fd = ::open( path.c_str(), O_RDONLY | O_CLOEXEC);
+		if( fd < 0)
+			return std::nullopt;
+
+		std::string bytes;
+		char buffer[ 4096];
+		for( ssize_t size; ( size = read( fd, buffer, sizeof buffer)) > 0;)
+			bytes.append( buffer, static_cast<size_t>( size));
+		::close( fd);
+
+		uint32_t count;
+		if( bytes.size() < HEADER_BYTES || bytes.compare( 0, sizeof MAGIC, MAGIC, sizeof MAGIC) != 0)
+			return std::nullopt;
+		std::memcpy( &count, bytes.data() + sizeof MAGIC, sizeof count);
+		if( bytes.size() != HEADER_BYTES + size_t{ count} * MATCH_BYTES)
+			return std::nullopt;
+
+		std::vector<Match> matches( count);
+		auto at = bytes.data() + HEADER_BYTES;
+		for( auto& m : matches)
+		{
+			std::memcpy( &m.key, at, 4);
+			std::memcpy( &m.row, at + 4, 4);
+			std::memcpy( &m.col, at + 8, 4);
+			m.direction = static_cast<uint8_t>( at[ 12]);
+			m.reversed  = static_cast<uint8_t>( at[ 13]);
+			at += MATCH_BYTES;
+		}
+		// Recently used entries are the last to be evicted.
+		utimensat( AT_FDCWD, path.c_str(), nullptr, 0);
+		return matches;
+	}
+
+	void store( const Sha256::Digest& key, const std::vector<Match>& matches)
+	{
+		auto name = Sha256::hex( key);
+		auto count = static_cast<uint32_t>( matches.size());
+		std::string bytes( MAGIC, sizeof MAGIC);
+		bytes.append( reinterpret_cast<const char *>( &count), sizeof count);
+		for( auto& m : matches)
+		{
+			char record[ MATCH_BYTES];
+			std::memcpy( record, &m.key, 4);
+			std::memcpy( record + 4, &m.row, 4);
+			std::memcpy( record + 8, &m.col, 4);
+			record[ 12] = static_cast<char>( m.direction);
+			record[ 13] = static_cast<char>( m.reversed);
+			bytes.append( record, MATCH_BYTES);
+		}
+
+		makeDirectories( m_directory + "/" + name.substr( 0, 2));
+		auto path = entryPath( name);
+		auto temporary = path + ".tmp." + std::to_string( getpid()) + "." + std::to_string( m_temporaries++);
+		int fd = ::open( temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+		if( fd < 0)
+			return;
+		bool written = ::write( fd, bytes.data(), bytes.size()) == static_cast<ssize_t>( bytes.size());
+		::close( fd);
+		if( !written || rename( temporary.c_str(), path.c_str()) != 0)
+		{
+			unlink( temporary.c_str());
+			return;
+		}
+
+		// Trim on the first store of a process, then after every eighth of the limit
+		// written, counted in the blocks entries take up on disk like the limit is.
+		auto blocks = ( bytes.size() + BLOCK_BYTES - 1) / BLOCK_BYTES * BLOCK_BYTES;
+		auto before = m_written.fetch_add( blocks);
+		if( before == 0 || before / ( m_max_bytes / 8 + 1) != ( before + blocks) / ( m_max_bytes / 8 + 1))
+			trim();
+	}
+
+private:
+	static constexpr char MAGIC[ 4]       = { 'P', 'Z', 'S', '1'};
+	static constexpr size_t HEADER_BYTES = sizeof MAGIC + 4;
+	static constexpr size_t MATCH_BYTES  = 14;
+	static constexpr size_t BLOCK_BYTES  = 4096;
+
+	std::string entryPath( const std::string& name) const
+	{
+		return m_directory + "/" + name.substr( 0, 2) + "/" + name;
+	}
+
+	/*
+	 * Remove the least recently used entries until the cache is down to three
+	 * quarters of its limit. Skipped while another thread of the process trims;
+	 * other processes take turns, each looking at what the last one left.
+	 */
+	void trim()
+	{
+		std::unique_lock<std::mutex> in_process( m_trimming, std::try_to_lock);
+		if( !in_process)
+			return;
+		int lock = ::open(( m_directory + "/.lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if( lock < 0)
+			return;
+		if( flock( lock, LOCK_EX) != 0)
+		{
+			::close( lock);
+			return;
+		}
+
+		std::vector<std::tuple<int64_t, uint64_t, std::string>> entries;   // mtime, size, path
+		uint64_t total = 0;
+		if( auto top = opendir( m_directory.c_str()))
+		{
+			while( auto shard = readdir( top))
+			{
+				if( shard->d_name[ 0] == '.')
+					continue;
+				auto shard_path = m_directory + "/" + shard->d_name;
+				auto files = opendir( shard_path.c_str());
+				if( !files)
+					continue;
+				while( auto file = readdir( files))
+				{
+					// Dot files and the temporaries of writers in flight are not entries.
+					if( file->d_name[ 0] == '.' || strchr( file->d_name, '.'))
+						continue;
+					auto path = shard_path + "/" + file->d_name;
+					struct stat info{};
+					if( stat( path.c_str(), &info) != 0)
+						continue;
+					// What the entry takes up on disk, which for small ones is a whole block.
+					auto size = static_cast<uint64_t>( info.st_blocks) * 512;
+					total += size;
+					entries.emplace_back( info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec, size, std::move( path));
+				}
+				closedir( files);
+			}
+			closedir( top);
+		}
+
+		if( total > m_max_bytes)
+		{
+			std::sort( entries.begin(), entries.end());
+			for( auto& [ mtime, size, path] : entries)
+			{
+				if( total <= m_max_bytes / 4 * 3)
+					break;
+				if( unlink( path.c_str()) == 0)
+					total -= size;
+			}
+		}
+		flock( lock, LOCK_UN);
+		::close( lock);
+	}
+
+	std::string m_directory;
+	uint64_t m_max_bytes;
+	std::atomic<uint64_t> m_written{}, m_temporaries{};
+	std::mutex m_trimming;
+};
+
+/*
+ * Matches found ahead of time by the engine numbered `engine`, viewed where
+ * they are kept, e.g. in a compiled puzzle archive. No engine is -1.
+ */
+struct KnownSolution
+{
+	int engine{ -1};
+	const SolutionCache::Match *matches{};
+	size_t size{};
+};
+
+}
+
+#endif //PUZZLER_SOLUTION_CACHE_HPP
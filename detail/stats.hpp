@@ -0,0 +1,160 @@
+#ifndef PUZZLER_STATS_HPP
+#define PUZZLER_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace detail
+{
+
+/*
+ * Process wide timings and counters behind `--stats`. Until enable() is
+ * called every probe is the test of one flag: no clock is read and nothing
+ * is counted. Probes may run on any thread; times of phases that run on
+ * several threads at once add up.
+ */
+class Stats
+{
+	using Clock = std::chrono::steady_clock;
+public:
+	enum Phase
+	{
+		PARSE,           // PuzzleFileReader::next()
+		PREPROCESS,      // PuzzleSolver::preprocess()
+		TRACKER_PASS,    // The tracker engine's sweep over the grid.
+		STALE_SWEEP,     // PuzzleSolver::compactTrackers()
+		DISPLAY,         // PuzzleSimulator::display()
+		FRAME,           // ScreenBuffer::present()
+		PHASES
+	};
+
+	enum Counter
+	{
+		PUZZLES_SOLVED,
+		TRACKERS_CREATED,
+		TRACKERS_DISCARDED,
+		COUNTERS
+	};
+
+	enum class Format
+	{
+		Table,
+		Json
+	};
+
+	static void enable( Format format)
+	{
+		s_format  = format;
+		s_enabled = true;
+	}
+
+	static bool enabled()
+	{
+		return s_enabled;
+	}
+
+	static void count( Counter counter, uint64_t n = 1)
+	{
+		if( s_enabled)
+			s_counters[ counter].fetch_add( n, std::memory_order_relaxed);
+	}
+
+	/*
+	 * Times `phase` for as long as it lives.
+	 */
+	class Timer
+	{
+	public:
+		explicit Timer( Phase phase)
+			: m_phase( phase)
+		{
+			if( s_enabled)
+				m_start = Clock::now();
+		}
+
+		Timer( const Timer&)            = delete;
+		Timer& operator=( const Timer&) = delete;
+
+		~Timer()
+		{
+			if( m_start == Clock::time_point{})
+				return;
+			auto ns = static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - m_start).count());
+			auto& phase = s_phases[ m_phase];
+			phase.calls.fetch_add( 1, std::memory_order_relaxed);
+			phase.total_ns.fetch_add( ns, std::memory_order_relaxed);
+			for( auto max = phase.max_ns.load( std::memory_order_relaxed); ns > max;)
+				if( phase.max_ns.compare_exchange_weak( max, ns, std::memory_order_relaxed))
+					break;
+		}
+
+	private:
+		Phase m_phase;
+		Clock::time_point m_start{};
+	};
+
+	/*
+	 * Print everything recorded to stderr, once; nothing unless enabled.
+	 */
+	static void report()
+	{
+		if( !s_enabled || s_reported.exchange( true))
+			return;
+
+		static constexpr const char *PHASE_NAMES[ PHASES] = {
+			"parse", "preprocess", "tracker_pass", "stale_sweep", "display", "frame"
+		};
+		static constexpr const char *COUNTER_NAMES[ COUNTERS] = {
+			"puzzles_solved", "trackers_created", "trackers_discarded"
+		};
+		auto ms = []( uint64_t ns) { return static_cast<double>( ns) / 1e6; };
+
+		if( s_format == Format::Json)
+		{
+			fprintf( stderr, "{\"phases\":{");
+			for( int p = 0; p < PHASES; ++p)
+			{
+				auto& phase = s_phases[ p];
+				fprintf( stderr, "%s\"%s\":{\"calls\":%llu,\"total_ms\":%.3f,\"max_ms\":%.3f}", p ? "," : "", PHASE_NAMES[ p],
+				         static_cast<unsigned long long>( phase.calls.load()), ms( phase.total_ns.load()), ms( phase.max_ns.load()));
+			}
+			fprintf( stderr, "},\"counters\":{");
+			for( int c = 0; c < COUNTERS; ++c)
+				fprintf( stderr, "%s\"%s\":%llu", c ? "," : "", COUNTER_NAMES[ c],
+				         static_cast<unsigned long long>( s_counters[ c].load()));
+			fprintf( stderr, "}}\n");
+			return;
+		}
+
+		fprintf( stderr, "%-20s %12s %14s %12s %12s\n", "phase", "calls", "total ms", "mean us", "max us");
+		for( int p = 0; p < PHASES; ++p)
+		{
+			auto& phase = s_phases[ p];
+			auto calls  = phase.calls.load();
+			fprintf( stderr, "%-20s %12llu %14.3f %12.3f %12.3f\n", PHASE_NAMES[ p], static_cast<unsigned long long>( calls),
+			         ms( phase.total_ns.load()), calls ? ms( phase.total_ns.load()) * 1e3 / static_cast<double>( calls) : 0.0,
+			         ms( phase.max_ns.load()) * 1e3);
+		}
+		fprintf( stderr, "\n%-20s %12s\n", "counter", "count");
+		for( int c = 0; c < COUNTERS; ++c)
+			fprintf( stderr, "%-20s %12llu\n", COUNTER_NAMES[ c], static_cast<unsigned long long>( s_counters[ c].load()));
+	}
+
+private:
+	struct PhaseTimes
+	{
+		std::atomic<uint64_t> calls, total_ns, max_ns;    // Zeroed like every static.
+	};
+
+	static inline bool s_enabled = false;
+	static inline Format s_format = Format::Table;
+	static inline std::atomic<bool> s_reported{ false};
+	static inline PhaseTimes s_phases[ PHASES];
+	static inline std::atomic<uint64_t> s_counters[ COUNTERS];
+};
+
+}
+
+#endif //PUZZLER_STATS_HPP
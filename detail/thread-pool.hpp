@@ -0,0 +1,191 @@
+#ifndef PUZZLER_THREAD_POOL_HPP
+#define PUZZLER_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * Work-stealing pool: every worker has a queue of its own and takes from its
+ * front, while idle workers steal from the back of the others. Tasks that a
+ * worker submits stay on its queue, so the tiles of a grid split by a batch
+ * task are picked up by that worker first and only spread out when the rest
+ * of the pool runs dry.
+ */
+class ThreadPool
+{
+public:
+	explicit ThreadPool( size_t n_threads = 0)
+	{
+		if( n_threads == 0)
+			n_threads = std::max( 1u, std::thread::hardware_concurrency());
+		for( size_t i = 0; i < n_threads; ++i)
+			queues.push_back( std::make_unique<Queue>());
+		workers.reserve( n_threads);
+		for( size_t i = 0; i < n_threads; ++i)
+			workers.emplace_back( [ this, i] { run( i); });
+	}
+
+	ThreadPool( const ThreadPool&)            = delete;
+	ThreadPool& operator=( const ThreadPool&) = delete;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex);
+			stopping = true;
+		}
+		has_work.notify_all();
+		for( auto& worker : workers)
+			worker.join();
+	}
+
+	void submit( std::function<void()> task)
+	{
+		++pending;
+		{
+			// Counted before it is visible, so a thief never takes the count below zero.
+			std::lock_guard<std::mutex> lock( mutex);
+			++queued;
+		}
+		auto& queue = *queues[ home()];
+		{
+			std::lock_guard<std::mutex> lock( queue.mutex);
+			queue.tasks.push_back( std::move( task));
+		}
+		has_work.notify_one();
+	}
+
+	/*
+	 * Block until every submitted task has run to completion.
+	 */
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock( mutex);
+		all_done.wait( lock, [ this] { return pending == 0; });
+	}
+
+	/*
+	 * Run `fn( i)` for every i below `n` and return once all of them are done.
+	 * The caller runs queued tasks while it waits, so this may be called from
+	 * inside a task without starving the pool; once there is nothing left to
+	 * steal it sleeps until the last of its tasks finishes.
+	 */
+	template<typename Fn>
+	void parallelFor( size_t n, Fn&& fn)
+	{
+		std::atomic<size_t> left{ n};
+		std::mutex done_mutex;
+		std::condition_variable done;
+		for( size_t i = 0; i < n; ++i)
+			submit( [ &fn, &left, &done_mutex, &done, i]
+			        {
+				        fn( i);
+				        std::lock_guard<std::mutex> lock( done_mutex);
+				        if( --left == 0)
+					        done.notify_all();
+			        });
+		while( left > 0 && runOne( home()))
+			;
+		// Whatever is left is running on other threads. Taking the lock also
+		// keeps `done` alive until the last task has let go of it.
+		std::unique_lock<std::mutex> lock( done_mutex);
+		done.wait( lock, [ &left] { return left == 0; });
+	}
+
+	size_t size() const
+	{
+		return workers.size();
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	// Queue a thread submits to and looks at first: its own for a worker,
+	// otherwise each submission goes to the next queue in turn.
+	size_t home()
+	{
+		if( current_pool == this)
+			return current_index;
+		return next_queue++ % queues.size();
+	}
+
+	bool runOne( size_t first)
+	{
+		std::function<void()> task;
+		for( size_t k = 0; !task && k < queues.size(); ++k)
+		{
+			auto& queue = *queues[ ( first + k) % queues.size()];
+			std::lock_guard<std::mutex> lock( queue.mutex);
+			if( queue.tasks.empty())
+				continue;
+			if( k == 0)
+			{
+				task = std::move( queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			else
+			{
+				task = std::move( queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+		}
+		if( !task)
+			return false;
+
+		--queued;
+		task();
+		if( --pending == 0)
+		{
+			std::lock_guard<std::mutex> lock( mutex);
+			all_done.notify_all();
+		}
+		return true;
+	}
+
+	void run( size_t index)
+	{
+		util::blockSignals();
+		current_pool  = this;
+		current_index = index;
+		for( ;;)
+		{
+			if( runOne( index))
+				continue;
+
+			std::unique_lock<std::mutex> lock( mutex);
+			has_work.wait( lock, [ this] { return stopping || queued > 0; });
+			if( stopping && queued == 0)
+				return;
+		}
+	}
+
+	static inline thread_local ThreadPool *current_pool = nullptr;
+	static inline thread_local size_t current_index     = 0;
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable has_work, all_done;
+	std::atomic<size_t> pending{}, queued{}, next_queue{};
+	bool stopping{};
+};
+
+}
+
+#endif //PUZZLER_THREAD_POOL_HPP
@@ -1,11 +1,15 @@
 ﻿#ifndef __UTIL__
 #define __UTIL__
 
+#include <csignal>
+#include <cstdint>
 #include <ctime>
+#include <pthread.h>
 #include <string>
 #include <thread>
 #include <chrono>
 #include <limits>
+#include <type_traits>
 
 #define NEG_INF std::numeric_limits<int>::min()
 
@@ -19,6 +23,57 @@ enum class Dir
 	NE, SW, NW, SE
 };
 
+inline const char *dirName( Dir direction )
+{
+	constexpr const char *names[] = { "NL", "N", "S", "W", "E", "NE", "SW", "NW", "SE" };
+	return names[ static_cast<int>( direction )];
+}
+
+inline Dir opposite( Dir direction )
+{
+	constexpr Dir flipped[] = { Dir::NL,
+	                            Dir::ST, Dir::NT, Dir::ET, Dir::WT,
+	                            Dir::SW, Dir::NE, Dir::SE, Dir::NW };
+	return flipped[ static_cast<int>( direction )];
+}
+
+// Row (DIR_DX) and column (DIR_DY) step of each direction, indexed by Dir; NL does not move.
+constexpr int DIR_DX[] = { 0, -1, 1,  0, 0, -1,  1, -1, 1 },
+              DIR_DY[] = { 0,  0, 0, -1, 1,  1, -1, -1, 1 };
+
+/*
+ * Direction of a single step of ( dx, dy), or NL when it is not one.
+ */
+constexpr Dir dirOf( int dx, int dy )
+{
+	constexpr Dir steps[] = { Dir::NW, Dir::NT, Dir::NE,
+	                          Dir::WT, Dir::NL, Dir::ET,
+	                          Dir::SW, Dir::ST, Dir::SE };
+	return dx < -1 || dx > 1 || dy < -1 || dy > 1 ? Dir::NL : steps[ ( dx + 1 ) * 3 + dy + 1];
+}
+
+/*
+ * Call `fn` with `direction` as a std::integral_constant, so that a kernel
+ * templated on it is compiled once per direction with constant steps and a
+ * single switch picks among them.
+ */
+template<typename Fn>
+decltype( auto ) withDir( Dir direction, Fn&& fn )
+{
+	switch( direction )
+	{
+		case Dir::NT: return fn( std::integral_constant<Dir, Dir::NT>{} );
+		case Dir::ST: return fn( std::integral_constant<Dir, Dir::ST>{} );
+		case Dir::WT: return fn( std::integral_constant<Dir, Dir::WT>{} );
+		case Dir::ET: return fn( std::integral_constant<Dir, Dir::ET>{} );
+		case Dir::NE: return fn( std::integral_constant<Dir, Dir::NE>{} );
+		case Dir::SW: return fn( std::integral_constant<Dir, Dir::SW>{} );
+		case Dir::NW: return fn( std::integral_constant<Dir, Dir::NW>{} );
+		case Dir::SE: return fn( std::integral_constant<Dir, Dir::SE>{} );
+		default:      return fn( std::integral_constant<Dir, Dir::NL>{} );
+	}
+}
+
 namespace util
 {
 
@@ -26,6 +81,61 @@ inline std::string reversed( const std::string& s )
 {
 	return { s.crbegin(), s.crend() };
 }
+
+#if defined( __GNUC__) || defined( __clang__)
+#define popcount8( x) __builtin_popcount( x)
+#else
+inline int popcount8( uint8_t v )
+{
+	v = static_cast<uint8_t>( ( v & 0x55 ) + ( ( v >> 1 ) & 0x55 ) );
+	v = static_cast<uint8_t>( ( v & 0x33 ) + ( ( v >> 2 ) & 0x33 ) );
+	return ( v & 0x0F ) + ( v >> 4 );
+}
+#endif
+
+/*
+ * Number of bytes in the UTF-8 sequence that starts with `c`.
+ */
+inline int byteCount( uint8_t c )
+{
+	// Check if leading byte is an ASCII character
+	if( ( c & 0x80 ) != 0x80 )
+		return 1;
+	// If not, reverse the byte
+	c = static_cast<uint8_t>( ( c & 0x55 ) << 1 ) | ( c & 0xAA ) >> 1;
+	c = static_cast<uint8_t>( ( c & 0x33 ) << 2 ) | ( c & 0xCC ) >> 2;
+	c = static_cast<uint8_t>( ( c & 0x0F ) << 4 ) | ( c & 0xFF ) >> 4;
+	// Mask out the continuous runs of ones in the leading byte( now trailing)
+	c = static_cast<uint8_t>( ( c ^ ( c + 1 ) ) >> 1 );
+	// Count the remaining bits in the byte.
+	return popcount8( c );
+}
+
+/*
+ * Number of code points in a UTF-8 string.
+ */
+inline size_t mb_strsize( const char *ps )
+{
+	size_t iters = 0;
+	while( *ps )
+	{
+		ps += byteCount( static_cast<uint8_t>( *ps ) );
+		++iters;
+	}
+
+	return iters;
+}
+
+/*
+ * Keep asynchronous signals on the main thread: worker threads call this
+ * first so SIGWINCH and SIGINT are never handled in their context.
+ */
+inline void blockSignals()
+{
+	sigset_t mask;
+	sigfillset( &mask );
+	pthread_sigmask( SIG_BLOCK, &mask, nullptr );
+}
 }
 }
 
@@ -0,0 +1,346 @@
+#ifndef PUZZLER_WORD_TRIE_HPP
+#define PUZZLER_WORD_TRIE_HPP
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "alphabet.hpp"
+#include "mapped-file.hpp"
+#include "puzzle-grid.hpp"
+#include "sha256.hpp"
+#include "solution-cache.hpp"
+#include "utility.hpp"
+
+namespace detail
+{
+
+/*
+ * Dictionary compiled into a trie and laid out flat in a file, so that a
+ * large word list is built once and then mapped read-only by every puzzle
+ * and thread that searches with it. In native byte order the file holds:
+ *
+ *   Header
+ *   Node     nodes[ nodes + 1]      edges of node i: [ nodes[ i].edge, nodes[ i + 1].edge)
+ *   uint32_t targets[ edges]        child reached by each edge
+ *   uint32_t offsets[ words + 1]    where each word starts in the text
+ *   char     labels[ edges]         byte of each edge, ascending per node
+ *   char     text[ text_bytes]      the words, back to back
+ */
+class WordTrie
+{
+public:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	/*
+	 * Open a compiled dictionary, or a word list through the compiled copy
+	 * kept next to it as `<list>.trie`, which is (re)built first when it is
+	 * missing or older than the list. Lists in directories that cannot be
+	 * written to, like /usr/share/dict, are compiled into the solution cache's
+	 * directory instead. nullptr if none of it works out.
+	 */
+	static std::shared_ptr<const WordTrie> fromFile( const std::string& path)
+	{
+		if( auto trie = open( path.c_str()))
+			return trie;
+
+		struct stat list{};
+		if( stat( path.c_str(), &list) != 0)
+			return nullptr;
+		for( auto beside : { true, false})
+		{
+			// A copy written by an older version does not open, and is rebuilt like a stale one.
+			auto compiled = beside ? path + ".trie" : cachedPath( path, list);
+			struct stat built{};
+			if( stat( compiled.c_str(), &built) == 0 && built.st_mtime >= list.st_mtime)
+				if( auto trie = open( compiled.c_str()))
+					return trie;
+			if( !compile( path.c_str(), compiled.c_str()))
+				continue;
+			if( auto trie = open( compiled.c_str()))
+				return trie;
+		}
+		return nullptr;
+	}
+
+	/*
+	 * Build the trie of the words in `list`, one per line, and write it to
+	 * `path`. Words are UTF-8 and upper-cased letter by letter, like keys;
+	 * lines holding anything but letters of the Alphabet are skipped. The
+	 * file is renamed into place once complete, so a concurrent reader never
+	 * maps half of it.
+	 */
+	static bool compile( const char *list, const char *path)
+	{
+		std::ifstream in( list);
+		if( !in)
+			return false;
+
+		std::vector<std::string> words;
+		for( std::string line; std::getline( in, line);)
+		{
+			while( !line.empty() && ( line.back() == '\r' || line.back() == ' '))
+				line.pop_back();
+			std::string word;
+			bool letters = !line.empty();
+			for( size_t i = 0; letters && i < line.size();)
+			{
+				auto letter = Alphabet::decode( line, i);
+				letters = Alphabet::isLetter( letter);
+				Alphabet::encode( Alphabet::upper( letter), word);
+			}
+			if( letters)
+				words.push_back( std::move( word));
+		}
+		std::sort( words.begin(), words.end());
+		words.erase( std::unique( words.begin(), words.end()), words.end());
+
+		// Sorted insertion appends every node's children in ascending order.
+		struct Building
+		{
+			std::vector<std::pair<char, uint32_t>> children;
+			uint32_t word{ NONE};
+		};
+		std::vector<Building> trie( 1);
+		for( uint32_t w = 0; w < words.size(); ++w)
+		{
+			uint32_t node = 0;
+			for( auto c : words[ w])
+			{
+				auto& children = trie[ node].children;
+				if( children.empty() || children.back().first != c)
+				{
+					children.emplace_back( c, static_cast<uint32_t>( trie.size()));
+					trie.emplace_back();
+				}
+				node = trie[ node].children.back().second;
+			}
+			trie[ node].word = w;
+		}
+
+		// Number the nodes breadth first, which keeps each node's edges together.
+		std::vector<uint32_t> order{ 0}, number( trie.size());
+		for( size_t k = 0; k < order.size(); ++k)
+			for( auto& edge : trie[ order[ k]].children)
+				order.push_back( edge.second);
+		for( uint32_t k = 0; k < order.size(); ++k)
+			number[ order[ k]] = k;
+
+		std::vector<Node> nodes;
+		std::vector<uint32_t> targets, offsets{ 0};
+		std::string labels, text;
+		for( auto old : order)
+		{
+			nodes.push_back( { static_cast<uint32_t>( targets.size()), trie[ old].word});
+			for( auto& edge : trie[ old].children)
+			{
+				labels += edge.first;
+				targets.push_back( number[ edge.second]);
+			}
+		}
+		nodes.push_back( { static_cast<uint32_t>( targets.size()), NONE});
+		for( auto& word : words)
+		{
+			text += word;
+			offsets.push_back( static_cast<uint32_t>( text.size()));
+		}
+
+		Header header{};
+		std::memcpy( header.magic, MAGIC, sizeof header.magic);
+		header.nodes      = static_cast<uint32_t>( order.size());
+		header.edges      = static_cast<uint32_t>( targets.size());
+		header.words      = static_cast<uint32_t>( words.size());
+		header.text_bytes = static_cast<uint32_t>( text.size());
+
+		auto partial = std::string( path) + ".partial";
+		{
+			std::ofstream out( partial, std::ios::binary | std::ios::trunc);
+			auto put = [ &out]( const void *data, size_t size)
+			{
+				out.write( static_cast<const char *>( data), static_cast<std::streamsize>( size));
+			};
+			put( &header, sizeof header);
+			put( nodes.data(), nodes.size() * sizeof( Node));
+			put( targets.data(), targets.size() * sizeof( uint32_t));
+			put( offsets.data(), offsets.size() * sizeof( uint32_t));
+			put( labels.data(), labels.size());
+			put( text.data(), text.size());
+			if( !out.flush())
+			{
+				std::remove( partial.c_str());
+				return false;
+			}
+		}
+		return std::rename( partial.c_str(), path) == 0;
+	}
+
+	/*
+	 * Map a compiled dictionary; nullptr if `path` does not hold one.
+	 */
+	static std::shared_ptr<const WordTrie> open( const char *path)
+	{
+		auto file = MappedFile::open( path);
+		if( !file || file->size() < sizeof( Header) || std::memcmp( file->data(), MAGIC, sizeof( Header::magic)) != 0)
+			return nullptr;
+
+		Header header;
+		std::memcpy( &header, file->data(), sizeof header);
+		auto expected = sizeof header + ( size_t{ header.nodes} + 1) * sizeof( Node)
+		                + ( size_t{ header.edges} + header.words + 1) * sizeof( uint32_t)
+		                + header.edges + header.text_bytes;
+		if( header.nodes == 0 || file->size() != expected)
+			return nullptr;
+		return std::shared_ptr<const WordTrie>( new WordTrie( std::move( file), header));
+	}
+
+	size_t size() const
+	{
+		return m_header.words;
+	}
+
+	std::string_view word( uint32_t id) const
+	{
+		return { m_text + m_offsets[ id], m_offsets[ id + 1] - m_offsets[ id]};
+	}
+
+	/*
+	 * Call sink( word id, row, col, direction) for every dictionary word that
+	 * can be read in `grid`. From each cell the trie is walked along every
+	 * direction and left as soon as no word continues with the next letter,
+	 * so most walks end after a step or two whatever the dictionary's size.
+	 * Cells past ASCII are walked through the UTF-8 of the letter they stand
+	 * for.
+	 */
+	template<typename Sink>
+	void search( const PuzzleGrid& grid, Sink&& sink) const
+	{
+		std::vector<std::string> spellings;
+		if( auto alphabet = grid.alphabet())
+			for( auto letter : alphabet->letters())
+				Alphabet::encode( letter, spellings.emplace_back());
+
+		for( size_t i = 0; i < grid.rows(); ++i)
+		{
+			for( size_t j = 0; j < grid.cols(); ++j)
+			{
+				auto first = step( 0, grid.at( i, j), spellings);
+				if( first == NONE)
+					continue;
+				// Single letters read the same every way; they are reported once, along S like keys.
+				if( m_nodes[ first].word != NONE)
+					sink( m_nodes[ first].word, static_cast<int>( i), static_cast<int>( j), Dir::ST);
+				for( int d = 1; d <= 8; ++d)
+					withDir( Dir( d), [ &]( auto direction) { walk<direction()>( grid, spellings, first, i, j, sink); });
+			}
+		}
+	}
+
+private:
+	/*
+	 * Where the compiled copy of `list` goes when it cannot go next to it:
+	 * named after the list's path, size and mtime, so an edited list gets a
+	 * copy of its own. The `.trie` suffix keeps the cache's trim() off it.
+	 */
+	static std::string cachedPath( const std::string& list, const struct stat& info)
+	{
+		std::string absolute = list;
+		if( auto resolved = realpath( list.c_str(), nullptr))
+		{
+			absolute = resolved;
+			free( resolved);
+		}
+		auto directory = SolutionCache::defaultDirectory() + "/tries";
+		SolutionCache::makeDirectories( directory);
+		Sha256 hash;
+		hash.update( absolute).update( std::to_string( info.st_size) + ":" + std::to_string( info.st_mtime));
+		return directory + "/" + Sha256::hex( hash.digest()) + ".trie";
+	}
+
+	static constexpr char MAGIC[ 8] = { 'P', 'Z', 'T', 'R', 'I', 'E', '2', '\0'};
+
+	struct Header
+	{
+		char magic[ 8];
+		uint32_t nodes, edges, words, text_bytes;
+	};
+
+	struct Node
+	{
+		uint32_t edge, word;
+	};
+
+	WordTrie( std::shared_ptr<const MappedFile> file, const Header& header)
+		: m_file( std::move( file)), m_header( header)
+	{
+		auto base  = m_file->data() + sizeof( Header);
+		m_nodes    = reinterpret_cast<const Node *>( base);
+		m_targets  = reinterpret_cast<const uint32_t *>( m_nodes + header.nodes + 1);
+		m_offsets  = m_targets + header.edges;
+		m_labels   = reinterpret_cast<const char *>( m_offsets + header.words + 1);
+		m_text     = m_labels + header.edges;
+	}
+
+	uint32_t child( uint32_t node, char c) const
+	{
+		auto first = m_labels + m_nodes[ node].edge, last = m_labels + m_nodes[ node + 1].edge;
+		// Labels ascend as bytes, the way the words were sorted, whatever the signedness of char.
+		auto edge  = std::lower_bound( first, last, c, []( char a, char b)
+		                               { return static_cast<uint8_t>( a) < static_cast<uint8_t>( b); });
+		return edge != last && *edge == c ? m_targets[ edge - m_labels] : NONE;
+	}
+
+	/*
+	 * Node reached from `node` by the letter of `cell`: one edge for ASCII,
+	 * one per byte of its UTF-8 otherwise.
+	 */
+	uint32_t step( uint32_t node, char cell, const std::vector<std::string>& spellings) const
+	{
+		auto id = static_cast<uint8_t>( cell);
+		if( id < Alphabet::FIRST)
+			return child( node, cell);
+		if( size_t{ id} - Alphabet::FIRST >= spellings.size())
+			return NONE;
+		for( auto c : spellings[ id - Alphabet::FIRST])
+			if( ( node = child( node, c)) == NONE)
+				break;
+		return node;
+	}
+
+	template<Dir D, typename Sink>
+	void walk( const PuzzleGrid& grid, const std::vector<std::string>& spellings, uint32_t node, size_t i, size_t j,
+	           Sink& sink) const
+	{
+		constexpr long dx = DIR_DX[ static_cast<int>( D)], dy = DIR_DY[ static_cast<int>( D)];
+		if constexpr( D != Dir::NL)
+		{
+			auto rows = static_cast<long>( grid.rows()), cols = static_cast<long>( grid.cols());
+			for( long x = static_cast<long>( i) + dx, y = static_cast<long>( j) + dy;
+			     x >= 0 && y >= 0 && x < rows && y < cols; x += dx, y += dy)
+			{
+				node = step( node, grid.at( static_cast<size_t>( x), static_cast<size_t>( y)), spellings);
+				if( node == NONE)
+					return;
+				if( m_nodes[ node].word != NONE)
+					sink( m_nodes[ node].word, static_cast<int>( i), static_cast<int>( j), D);
+			}
+		}
+	}
+
+	std::shared_ptr<const MappedFile> m_file;
+	Header m_header;
+	const Node *m_nodes;
+	const uint32_t *m_targets, *m_offsets;
+	const char *m_labels, *m_text;
+};
+
+}
+
+#endif //PUZZLER_WORD_TRIE_HPP
@@ -6,27 +6,20 @@
 #include <deque>
 #include <cstdlib>
 #include <csignal>
-#include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
 #include "detail/puzzle-simulator.hpp"
 #include "detail/option-builder.hpp"
-
-#define NOT_SET  nullptr
+#include "detail/puzzle-reader.hpp"
+#include "detail/puzzle-feed.hpp"
+#include "detail/puzzle-archive.hpp"
+#include "detail/batch-solver.hpp"
+#include "detail/simulator-cache.hpp"
+#include "detail/puzzle-generator.hpp"
 
 namespace detail
 {
 
-static void resize_handler( int signal)
-{
-	if( SIGWINCH != signal)
-		return;
-	struct winsize window_size{};
-	ioctl(0, TIOCGWINSZ, &window_size);
-	auto w_instance = detail::EventDog::instance();
-	w_instance->setWinSize(window_size.ws_row, window_size.ws_col);
-}
-
 static struct termios orig_term_state;
 static void refresh_before_exit( int signal)
 {
@@ -38,19 +31,13 @@ static void refresh_before_exit( int signal)
 
 	// Turn-off focus control
 	printf( "\x1B[?1004l");
+	fflush( stdout);
+	// The handler that would print them is skipped by _Exit().
+	detail::Stats::report();
 
 	// exit() must not be called here to avoid infinite loop
 	_Exit( signal);
 }
-
-namespace util
-{
-template<typename Pred, typename First, typename... Others>
-bool compareAnd( First base, Others... others)
-{
-	return ( ... && Pred()( base, others));
-}
-}
 }
 
 
@@ -72,6 +59,28 @@ int main( int argc, char *argv[])
 					   "The forward and rewind button switches to first and last on reaching the end.")
 		   .addOption( "auto-next", "a", "no", "Press `next` before next puzzle is run.")
 		   .addOption( "reverse-solve", "r", "no", "Reverse the effect of forward and rewind button.")
+		   .addOption( "batch", "B", "json",
+					   "Solve every puzzle without the simulator and print the matches as `json` or `csv`.", 0)
+		   .addOption( "all-occurrences", "A", {}, "Batch: report every occurrence of every key, not just the first one.", 0)
+		   .addOption( "dictionary", "d", "Batch: find every word of this list, or of its compiled trie, instead of the keys.")
+		   .addOption( "max-errors", "k", {}, "Batch: report each key's best placement with up to this many edits; `?` in keys matches any letter.")
+		   .addOption( "cache", "c", {}, "Keep solutions on disk and reuse them, under ~/.cache/puzzler or `--cache=DIR`.", 0)
+		   .addOption( "cache-size", {}, "256", "Cache: size in MiB past which the least recently used solutions go.")
+		   .addOption( "stats", {}, {}, "Print phase timings and counters to stderr on exit, as a table or `--stats=json`.", 0)
+		   .addOption( "threads", "j", "0", "Set the number of solver threads (0 = all cores).")
+		   .addOption( "engine", "e", "tracker", "Set the solver engine: `tracker`, `aho-corasick`, `scan`, `bitboard` or `packed`.")
+		   .addOption( "compile", {}, {}, "Write the puzzles of a text file to a binary archive: `--compile in.txt out.pzb`.", 2)
+		   .addOption( "precompute", {}, {}, "Compile: also solve every puzzle with --engine and store the matches.", 0)
+		   .addOption( "generate", "g", {}, "Print a synthetic puzzle file built from the options below instead of solving.", 0)
+		   .addOption( "seed", {}, "1", "Generator: seed; the same options and seed give the same file.")
+		   .addOption( "count", {}, "1", "Generator: number of puzzles.")
+		   .addOption( "rows", {}, "20", "Generator: grid height, up to 10000.")
+		   .addOption( "cols", {}, "20", "Generator: grid width, up to 10000.")
+		   .addOption( "keys", {}, "20", "Generator: number of keys per puzzle.")
+		   .addOption( "key-length", {}, "3-10", "Generator: key length range, as `min-max`.")
+		   .addOption( "directions", {}, "E,S,SE,SW", "Generator: directions keys are written in, or `all`.")
+		   .addOption( "reversed", {}, "0.5", "Generator: share of keys written back to front.")
+		   .addOption( "decoys", {}, "0", "Generator: near misses planted per key.")
 		   .build();
 
 	if( !builder.asDefault( "help").empty())
@@ -80,6 +89,109 @@ int main( int argc, char *argv[])
 		exit( EXIT_SUCCESS);
 	}
 
+	if( auto stats = builder.asDefault( "stats"); !stats.empty())
+	{
+		if( stats != "stats" && stats != "table" && stats != "json")
+		{
+			fprintf( stderr, "Unknown stats format: %s\n", stats.c_str());
+			exit( EXIT_FAILURE);
+		}
+		detail::Stats::enable( stats == "json" ? detail::Stats::Format::Json : detail::Stats::Format::Table);
+		atexit( [] { detail::Stats::report();});
+	}
+
+	if( !builder.asDefault( "generate").empty())
+	{
+		// Defaults are not applied by the builder, so every option falls back here.
+		auto given = [ &]( const char *key, const char *fallback)
+		{
+			auto value = builder.asDefault( key);
+			return value.empty() ? std::string( fallback) : value;
+		};
+		auto count = [ &]( const char *key, const char *fallback)
+		{
+			return static_cast<size_t>( std::max( 0L, strtol( given( key, fallback).c_str(), nullptr, 10)));
+		};
+
+		detail::GeneratorSpec spec;
+		spec.seed     = strtoull( given( "seed", "1").c_str(), nullptr, 10);
+		spec.puzzles  = count( "count", "1");
+		spec.rows     = count( "rows", "20");
+		spec.cols     = count( "cols", "20");
+		spec.keys     = count( "keys", "20");
+		spec.reversed = strtod( given( "reversed", "0.5").c_str(), nullptr);
+		spec.decoys   = std::max( 0.0, strtod( given( "decoys", "0").c_str(), nullptr));
+		auto lengths  = given( "key-length", "3-10");
+		auto dash     = lengths.find( '-');
+		spec.min_length = static_cast<size_t>( std::max( 0L, strtol( lengths.c_str(), nullptr, 10)));
+		spec.max_length = dash == std::string::npos ? spec.min_length
+		                  : static_cast<size_t>( std::max( 0L, strtol( lengths.c_str() + dash + 1, nullptr, 10)));
+		auto directions = detail::PuzzleGenerator::parseDirections( given( "directions", "E,S,SE,SW"));
+
+		if( spec.rows == 0 || spec.cols == 0 || spec.rows > 10000 || spec.cols > 10000)
+		{
+			fprintf( stderr, "Grid size must be between 1x1 and 10000x10000\n");
+			exit( EXIT_FAILURE);
+		}
+		if( spec.min_length == 0 || spec.max_length < spec.min_length)
+		{
+			fprintf( stderr, "Invalid key length range: %s\n", lengths.c_str());
+			exit( EXIT_FAILURE);
+		}
+		if( !directions)
+		{
+			fprintf( stderr, "Invalid directions: %s\n", builder.asDefault( "directions").c_str());
+			exit( EXIT_FAILURE);
+		}
+		spec.directions = *directions;
+
+		std::ios::sync_with_stdio( false);
+		detail::PuzzleGenerator( spec).write( std::cout);
+		std::cout.flush();
+		exit( EXIT_SUCCESS);
+	}
+
+	if( auto compile = builder.get( "compile"); !compile.empty())
+	{
+		if( compile.size() != 2)
+		{
+			fprintf( stderr, "Usage: --compile puzzle-file archive-file\n");
+			exit( EXIT_FAILURE);
+		}
+		auto text = detail::MappedFile::open( compile[ 0].c_str());
+		if( !text)
+		{
+			fprintf( stderr, "Invalid file!");
+			exit( 1);
+		}
+		auto engine = PuzzleSolver::engineFromName( builder.asDefault( "engine"));
+		if( !engine)
+		{
+			fprintf( stderr, "Unknown solver engine: %s\n", builder.asDefault( "engine").c_str());
+			exit( EXIT_FAILURE);
+		}
+
+		PuzzleFileReader reader( std::move( text));
+		auto n_threads = builder.asInt( "threads");
+		detail::ThreadPool tiles( n_threads > 0 ? static_cast<size_t>( n_threads) : 0);
+		std::function<std::vector<detail::SolutionCache::Match>( const PuzzleImage&)> solve;
+		if( !builder.asDefault( "precompute").empty())
+			solve = [ &]( const PuzzleImage& image)
+			{
+				PuzzleSolver solver( image.puzzle, image.keys);
+				solver.useEngine( *engine);
+				solver.useThreadPool( &tiles);
+				solver.solve();
+				return solver.solution();
+			};
+		if( !detail::PuzzleArchive::compile( reader, compile[ 1], static_cast<int>( *engine), solve))
+		{
+			fprintf( stderr, "Unable to write archive: %s\n", compile[ 1].c_str());
+			exit( EXIT_FAILURE);
+		}
+		exit( EXIT_SUCCESS);
+	}
+
 	auto maybe_file = builder.asDefault( "file");
 	if( !maybe_file.empty())
 		puzzle_file = maybe_file.data();
@@ -90,31 +202,98 @@ int main( int argc, char *argv[])
 		exit( EXIT_FAILURE);
 	}
 
-	auto scope = std::ifstream( puzzle_file.data());
+	auto scope = detail::MappedFile::open( std::string( puzzle_file).c_str());
 	if( !scope)
 	{
 		fprintf( stderr, "Invalid file!");
 		exit( 1);
 	}
 
-	PuzzleFileReader reader( scope);
-	auto response = reader.getPuzzles();
-	if( response.empty())
+	// Compiled archives are used as they are. Text is parsed in the background;
+	// only the first puzzle is waited for here.
+	auto archive = detail::PuzzleArchive::open( scope);
+	std::optional<PuzzleFileReader> reader;
+	detail::PuzzleFeed feed = archive ? detail::PuzzleFeed( std::move( archive))
+	                                  : detail::PuzzleFeed( reader.emplace( std::move( scope)));
+	if( !feed.get( 0))
 	{
 		fprintf( stderr, "Invalid file!");
 		exit( 1);
 	}
 
-	struct sigaction resize_action{};
-	resize_action.sa_handler = detail::resize_handler;
-	sigaction( SIGWINCH, &resize_action, NOT_SET);
-	raise( SIGWINCH);   // Get current window size.
+	auto engine = PuzzleSolver::engineFromName( builder.asDefault( "engine"));
+	if( !engine)
+	{
+		fprintf( stderr, "Unknown solver engine: %s\n", builder.asDefault( "engine").c_str());
+		exit( EXIT_FAILURE);
+	}
+
+	// A bare --cache reads as its own name.
+	std::optional<detail::SolutionCache> cache;
+	if( auto directory = builder.asDefault( "cache"); !directory.empty())
+	{
+		auto megabytes = builder.asInt( "cache-size");
+		cache.emplace( directory == "cache" ? detail::SolutionCache::defaultDirectory() : directory,
+		               static_cast<uint64_t>( megabytes > 0 ? megabytes : 256) << 20);
+	}
+
+	auto dictionary = builder.asDefault( "dictionary");
+	auto max_errors = builder.asDefault( "max-errors");
+	if( auto batch = builder.asDefault( "batch"); !batch.empty() || !dictionary.empty() || !max_errors.empty())
+	{
+		auto format = detail::BatchSolver::parseFormat( batch);
+		if( !format)
+		{
+			fprintf( stderr, "Unknown batch format: %s\n", batch.c_str());
+			exit( EXIT_FAILURE);
+		}
+		auto n_threads = builder.asInt( "threads");
+		detail::BatchSolver batch_solver( std::cout, *format, *engine,
+		                                  n_threads > 0 ? static_cast<size_t>( n_threads) : 0);
+		batch_solver.allOccurrences( !builder.asDefault( "all-occurrences").empty());
+		batch_solver.useCache( cache ? &*cache : nullptr);
+		if( !max_errors.empty())
+		{
+			if( !dictionary.empty())
+			{
+				fprintf( stderr, "--max-errors cannot be combined with --dictionary\n");
+				exit( EXIT_FAILURE);
+			}
+			char *end = nullptr;
+			auto errors = strtol( max_errors.c_str(), &end, 10);
+			if( end == max_errors.c_str() || *end != '\0' || errors < 0)
+			{
+				fprintf( stderr, "Invalid number of errors: %s\n", max_errors.c_str());
+				exit( EXIT_FAILURE);
+			}
+			batch_solver.maxErrors( static_cast<size_t>( errors));
+		}
+		if( !dictionary.empty())
+		{
+			auto trie = detail::WordTrie::fromFile( dictionary);
+			if( !trie)
+			{
+				fprintf( stderr, "Unable to load dictionary: %s\n", dictionary.c_str());
+				exit( EXIT_FAILURE);
+			}
+			batch_solver.useDictionary( std::move( trie));
+		}
+		batch_solver.solve( feed);
+		exit( EXIT_SUCCESS);
+	}
+
+	detail::EventDog::refreshWinSize();
 	// If $LINES and $COLUMNS is non-zero, terminal supports cursor motion.
 	if( detail::EventDog::getWinLines() && detail::EventDog::getWinCols())
 	{
+		// From here on SIGWINCH and SIGINT arrive as events of the loop rather than
+		// interrupting whatever runs; the size may have changed in between. Only
+		// while a puzzle is being solved does SIGINT still go to the handler.
 		struct sigaction refresh_action{};
 		refresh_action.sa_handler = detail::refresh_before_exit;
-		sigaction( SIGINT, &refresh_action, NOT_SET);
+		sigaction( SIGINT, &refresh_action, nullptr);
+		detail::EventLoop::instance();
+		detail::EventDog::refreshWinSize();
 		atexit( [] { detail::refresh_before_exit( EXIT_SUCCESS);});
 
 		struct termios raw_term_state{};
@@ -137,44 +316,77 @@ int main( int argc, char *argv[])
 		// Turn-on focus control
 		printf( "\x1B[?1004h");
 
-		auto step = builder.asBool( "reverse-solve") ? -1 : 1;
-		std::vector<std::unique_ptr<TerminalPuzzleSimulator>> sims( response.size());
-		auto g_begin = step == -1 ? --response.cend() : response.cbegin(),
-			 g_end   = step == -1 ? --response.begin() : response.cend();
-		for( auto begin = g_begin, end = g_end; begin != end;)
+		auto reverse = builder.asBool( "reverse-solve"),
+		     wrap    = builder.asBool( "wrap");
+		// Move one puzzle along the viewing order, wrapping around or staying put at either end.
+		// Only wrapping past the first puzzle needs the whole file to have been parsed.
+		auto neighbour = [ &]( size_t index, bool forward) -> size_t
 		{
-			// Calculate the puzzle number to indicate at the top
-			auto puzzle_number = static_cast<size_t>( std::distance( response.cbegin(), begin)) + 1;
-			PuzzleSolver solver( begin->puzzle, begin->keys);
-			if( !sims[ puzzle_number - 1])
-				sims[ puzzle_number - 1] = std::make_unique<TerminalPuzzleSimulator>( solver, builder);
+			if( forward != reverse)
+				return feed.get( index + 1) ? index + 1 : ( wrap ? 0 : index);
+			return index > 0 ? index - 1 : ( wrap ? feed.size() - 1 : index);
+		};
 
-			auto& term_simulator = sims[ puzzle_number - 1];
+		// Tiles of a large grid are solved in parallel on this pool.
+		auto n_threads = builder.asInt( "threads");
+		detail::ThreadPool tiles( n_threads > 0 ? static_cast<size_t>( n_threads) : 0);
+		detail::SimulatorCache sims( [ &]( size_t index)
+		                             {
+			                             auto image = feed.get( index);
+			                             PuzzleSolver solver( image->puzzle, image->keys);
+			                             solver.useEngine( *engine);
+			                             solver.useThreadPool( &tiles);
+			                             solver.useCache( cache ? &*cache : nullptr);
+			                             solver.useKnownSolution( image->solution);
+			                             return std::make_unique<TerminalPuzzleSimulator>( std::move( solver), builder);
+		                             }, neighbour);
+		for( size_t index = reverse ? feed.size() - 1 : 0;;)
+		{
+			// Calculate the puzzle number to indicate at the top
+			auto puzzle_number = index + 1;
+			TerminalPuzzleSimulator *term_simulator;
+			{
+				// Building it may mean solving it first, which the loop cannot interrupt.
+				detail::EventLoop::Interruptible interruptible;
+				term_simulator = sims.acquire( index);
+			}
+			// Solve the puzzles either key press leads to while this one animates.
+			sims.around( index);
 			term_simulator->setSimulatorSpeed(( int)builder.asInt("speed"));
-			detail::EventDog::registerWinUpdateCallback([ &term_simulator, &puzzle_number](bool refresh)
-			                                          {
-				                                          term_simulator->simulate( std::cout, puzzle_number, refresh);
-			                                          });
 			// Returns indication that this run completed.
 			auto status = term_simulator->simulate( std::cout, puzzle_number, false);
 			printf("\x1B[?25l");
-			char input{};
-			while( status == detail::Conclusion::Finished  && !builder.asBool( "auto-next") &&
-			       detail::util::compareAnd<std::not_equal_to<char>>( input = static_cast<char>( std::getchar()),
-				   Q( KEY_QUIT), Q( KEY_RESTART), Q( KEY_NEXT), Q( KEY_REWIND)))
-				;
-			if( status == detail::Conclusion::Rewind || input == Q( KEY_REWIND))
+			auto event = detail::Event::NoOp;
+			for( bool waiting = status == detail::Conclusion::Finished && !builder.asBool( "auto-next"); waiting;)
+			{
+				switch( event = detail::nextEvent())
+				{
+					case detail::Event::Resize:
+						term_simulator->simulate( std::cout, puzzle_number, true);
+						break;
+					case detail::Event::Interrupt:
+						exit( EXIT_SUCCESS);
+					case detail::Event::Quit:
+					case detail::Event::Restart:
+					case detail::Event::Next:
+					case detail::Event::Previous:
+						waiting = false;
+						break;
+					default:
+						break;
+				}
+			}
+			if( status == detail::Conclusion::Rewind || event == detail::Event::Previous)
 			{
-				begin = begin != g_begin ? begin - step
-						: builder.asBool( "wrap") ? g_end - step : begin;
+				index = neighbour( index, false);
 				continue;
 			}
-			else if( input == Q( KEY_RESTART))
+			else if( event == detail::Event::Restart)
 				continue;
-			else if( input == Q( KEY_QUIT))
+			else if( event == detail::Event::Quit)
 				exit( EXIT_SUCCESS);
 
-			begin = begin + step == g_end ? ( builder.asBool( "wrap") ? g_begin : begin) : begin + step;
+			index = neighbour( index, true);
 		}
 	}
 	else
@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include "../detail/batch-solver.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+constexpr PuzzleSolver::Engine ENGINES[] = {
+	PuzzleSolver::Engine::Tracker, PuzzleSolver::Engine::AhoCorasick, PuzzleSolver::Engine::Scan,
+	PuzzleSolver::Engine::Bitboard, PuzzleSolver::Engine::Packed
+};
+
+enum class Mode
+{
+	FIRST,
+	ALL,
+	APPROXIMATE
+};
+
+std::string batch( const std::string& file, PuzzleSolver::Engine engine, Mode mode)
+{
+	std::istringstream in( file);
+	PuzzleFileReader reader( in);
+	detail::PuzzleFeed feed( reader);
+	std::ostringstream out;
+	detail::BatchSolver solver( out, detail::BatchSolver::Format::Json, engine, 1);
+	solver.allOccurrences( mode == Mode::ALL);
+	if( mode == Mode::APPROXIMATE)
+		solver.maxErrors( 0);
+	solver.solve( feed);
+	return out.str();
+}
+
+/*
+ * Letters are upper-cased one by one, and take ids of their own in the
+ * order they are first seen.
+ */
+void mapping()
+{
+	using detail::Alphabet;
+	CHECK( Alphabet::upper( 'q') == 'Q' && Alphabet::upper( 'Q') == 'Q' && Alphabet::upper( '?') == '?');
+	CHECK( Alphabet::upper( 0x3B3) == 0x393);                                 // γ
+	CHECK( Alphabet::upper( 0x3C2) == 0x3A3 && Alphabet::upper( 0x3C3) == 0x3A3); // ς, σ
+	CHECK( Alphabet::upper( 0x3AD) == 0x388);                                 // έ
+	CHECK( Alphabet::upper( 0x44F) == 0x42F && Alphabet::upper( 0x451) == 0x401); // я, ё
+	CHECK( Alphabet::upper( 0x101) == 0x100 && Alphabet::upper( 0x100) == 0x100); // ā
+	CHECK( Alphabet::upper( 0xDF) == 0xDF);                                   // ß
+	CHECK( Alphabet::isLetter( 0x3B3) && !Alphabet::isLetter( 0x301) && !Alphabet::isLetter( '1'));
+
+	Alphabet alphabet;
+	CHECK( alphabet.idOf( 'K') == 'K' && alphabet.empty());
+	CHECK( alphabet.idOf( 0x393) == Alphabet::FIRST && alphabet.idOf( 0x416) == Alphabet::FIRST + 1);
+	CHECK( alphabet.idOf( 0x393) == Alphabet::FIRST);
+	std::string spelled;
+	alphabet.spell( std::string{ 'K', char( Alphabet::FIRST + 1), char( Alphabet::FIRST)}, spelled);
+	CHECK( spelled == "KЖΓ");
+	for( char32_t letter = 0x4E0; alphabet.letters().size() < Alphabet::CAPACITY; ++letter)
+		CHECK( alphabet.idOf( letter) != 0);
+	CHECK( alphabet.idOf( 0x5D0) == 0 && alphabet.idOf( 0x393) == Alphabet::FIRST);
+
+	std::string text = "aγЖ\xFF";
+	size_t i = 0;
+	CHECK( Alphabet::decode( text, i) == 'a' && Alphabet::decode( text, i) == 0x3B3);
+	CHECK( Alphabet::decode( text, i) == 0x416 && Alphabet::decode( text, i) == Alphabet::INVALID && i == text.size());
+}
+
+/*
+ * Grids and keys match whatever case either is written in, down to the
+ * final sigma, with every engine, for every occurrence and for
+ * approximate searches alike.
+ */
+void caseFolded()
+{
+	const std::string grids[] = {
+		"ΓΑΜΜΑQ\nΔΈΛΤΑΣ\nCATXYZ\n",
+		"γαμμαq\nδέλτας\ncatxyz\n",
+		"γΑμΜαQ\nΔέλΤασ\nCaTxYz\n"
+	};
+	const std::string keys[] = {
+		"ΓΑΜΜΑ\nΔΈΛΤΑΣ\nCAT\n",
+		"γαμμα\nδέλτασ\ncat\n",
+		"ΓαΜμΑ\nδΈλΤαΣ\ncAt\n"
+	};
+	auto file = []( const std::string& grid, const std::string& key)
+	{
+		return "Puzzle:\n" + grid + "Key:\n" + key + "end:\n";
+	};
+
+	auto expected = batch( file( grids[ 0], keys[ 0]), PuzzleSolver::Engine::Scan, Mode::FIRST);
+	CHECK( expected == "{\"puzzle\":1,\"word\":\"CAT\",\"row\":2,\"col\":0,\"direction\":\"E\",\"reversed\":false}\n"
+	                   "{\"puzzle\":1,\"word\":\"ΓΑΜΜΑ\",\"row\":0,\"col\":0,\"direction\":\"E\",\"reversed\":false}\n"
+	                   "{\"puzzle\":1,\"word\":\"ΔΈΛΤΑΣ\",\"row\":1,\"col\":0,\"direction\":\"E\",\"reversed\":false}\n");
+	auto all         = batch( file( grids[ 0], keys[ 0]), PuzzleSolver::Engine::Scan, Mode::ALL);
+	auto approximate = batch( file( grids[ 0], keys[ 0]), PuzzleSolver::Engine::Scan, Mode::APPROXIMATE);
+	CHECK( !all.empty() && !approximate.empty());
+
+	for( auto& grid : grids)
+		for( auto& key : keys)
+		{
+			for( auto engine : ENGINES)
+				CHECK( batch( file( grid, key), engine, Mode::FIRST) == expected);
+			CHECK( batch( file( grid, key), PuzzleSolver::Engine::Scan, Mode::ALL) == all);
+			CHECK( batch( file( grid, key), PuzzleSolver::Engine::Scan, Mode::APPROXIMATE) == approximate);
+		}
+}
+
+}
+
+int main()
+{
+	mapping();
+	caseFolded();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../detail/batch-solver.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+struct Puzzle
+{
+	std::vector<std::string> rows, keys;
+};
+
+/*
+ * A grid over eight letters and distinct keys of three to six, some read
+ * off the grid with a letter changed, left out or put in, some with a `?`.
+ */
+Puzzle fuzzed( std::mt19937& random, size_t rows, size_t cols)
+{
+	const std::string letters = "ABCDEFGH";
+	auto pick = [ &]( size_t n) { return std::uniform_int_distribution<size_t>( 0, n - 1)( random); };
+	Puzzle puzzle;
+	for( size_t i = 0; i < rows; ++i)
+	{
+		puzzle.rows.emplace_back();
+		for( size_t j = 0; j < cols; ++j)
+			puzzle.rows.back() += letters[ pick( letters.size())];
+	}
+	std::set<std::string> seen;
+	for( size_t k = 0; k < 12; ++k)
+	{
+		std::string key;
+		auto d = 1 + pick( 8);
+		int x = static_cast<int>( pick( rows)), y = static_cast<int>( pick( cols));
+		for( ; x >= 0 && y >= 0 && x < static_cast<int>( rows) && y < static_cast<int>( cols) && key.size() < 6;
+		     x += detail::DIR_DX[ d], y += detail::DIR_DY[ d])
+			key += puzzle.rows[ static_cast<size_t>( x)][ static_cast<size_t>( y)];
+		while( key.size() < 3)
+			key += letters[ pick( letters.size())];
+		switch( pick( 5))
+		{
+			case 0: key[ pick( key.size())] = letters[ pick( letters.size())]; break;
+			case 1: if( key.size() > 3) key.erase( pick( key.size()), 1); break;
+			case 2: key.insert( pick( key.size() + 1), 1, letters[ pick( letters.size())]); break;
+			case 3: key[ pick( key.size())] = '?'; break;
+			default: break;
+		}
+		if( key.find_first_not_of( '?') != std::string::npos && seen.insert( key).second)
+			puzzle.keys.push_back( key);
+	}
+	return puzzle;
+}
+
+/*
+ * Plain Levenshtein distance, with `?` in the key standing for any letter.
+ */
+size_t distance( const std::string& key, const std::string& text)
+{
+	std::vector<size_t> previous( text.size() + 1), current( text.size() + 1);
+	for( size_t j = 0; j <= text.size(); ++j)
+		previous[ j] = j;
+	for( size_t i = 1; i <= key.size(); ++i)
+	{
+		current[ 0] = i;
+		for( size_t j = 1; j <= text.size(); ++j)
+		{
+			auto same = key[ i - 1] == text[ j - 1] || key[ i - 1] == '?';
+			current[ j] = std::min( { previous[ j - 1] + ( same ? 0 : 1), previous[ j] + 1, current[ j - 1] + 1});
+		}
+		std::swap( previous, current);
+	}
+	return previous[ text.size()];
+}
+
+/*
+ * Fewest edits `key` is from any run of cells read from (x, y) along `d`, or
+ * from any cell and direction when x is negative.
+ */
+size_t fewest( const Puzzle& puzzle, const std::string& key, int x = -1, int y = -1, int d = 0)
+{
+	auto rows = static_cast<int>( puzzle.rows.size()), cols = static_cast<int>( puzzle.rows[ 0].size());
+	auto best = SIZE_MAX;
+	for( int i = 0; i < rows; ++i)
+		for( int j = 0; j < cols; ++j)
+			for( int e = 1; e <= 8; ++e)
+			{
+				if( x >= 0 && ( i != x || j != y || e != d))
+					continue;
+				std::string text;
+				for( int a = i, b = j; a >= 0 && b >= 0 && a < rows && b < cols; a += detail::DIR_DX[ e], b += detail::DIR_DY[ e])
+				{
+					text += puzzle.rows[ static_cast<size_t>( a)][ static_cast<size_t>( b)];
+					best = std::min( best, distance( key, text));
+				}
+			}
+	return best;
+}
+
+/*
+ * Each key is placed with the fewest edits a brute force over every run of
+ * cells finds, or not at all when that is over the limit, and the run it is
+ * placed on, read from its first letter, is that few edits away.
+ */
+void fewestEdits()
+{
+	std::mt19937 random( 25);
+	for( int i = 0; i < 200; ++i)
+	{
+		auto puzzle = fuzzed( random, 1 + random() % 9, 1 + random() % 9);
+		std::vector<std::string_view> keys( puzzle.keys.begin(), puzzle.keys.end());
+		detail::PuzzleGrid grid( puzzle.rows);
+		detail::ApproximateSearch search( grid);
+		for( size_t max_errors : { 0, 1, 2})
+		{
+			auto found = search.best( keys, max_errors);
+			CHECK( found.size() == keys.size());
+			for( size_t k = 0; k < keys.size(); ++k)
+			{
+				auto expected = fewest( puzzle, puzzle.keys[ k]);
+				CHECK( found[ k].found() == ( expected <= max_errors));
+				if( !found[ k].found())
+					continue;
+				CHECK( found[ k].errors == expected);
+				CHECK( fewest( puzzle, puzzle.keys[ k], found[ k].row, found[ k].col, static_cast<int>( found[ k].direction))
+				       == expected);
+			}
+		}
+	}
+}
+
+std::string batch( const std::string& file, std::optional<size_t> max_errors)
+{
+	std::istringstream in( file);
+	PuzzleFileReader reader( in);
+	detail::PuzzleFeed feed( reader);
+	std::ostringstream out;
+	detail::BatchSolver solver( out, detail::BatchSolver::Format::Json, PuzzleSolver::Engine::Scan, 2);
+	solver.maxErrors( max_errors);
+	solver.solve( feed);
+	return out.str();
+}
+
+/*
+ * With no edits allowed, the records are those of an exact solve with an
+ * error count added, in the same order, keys that are each other's
+ * reversal included.
+ */
+void exactWithoutEdits()
+{
+	std::mt19937 random( 0);
+	std::string file;
+	for( int i = 0; i < 100; ++i)
+	{
+		auto puzzle = fuzzed( random, 1 + random() % 12, 1 + random() % 12);
+		file += "Puzzle:\n";
+		for( auto& row : puzzle.rows)
+			file += row + '\n';
+		file += "Key:\n";
+		for( auto& key : puzzle.keys)
+			if( key.find( '?') == std::string::npos)
+				file += key + '\n';
+	}
+	file += "end:\n";
+
+	auto approximate = batch( file, 0);
+	std::string stripped;
+	for( size_t at = 0, end; ( end = approximate.find( ",\"errors\":0}\n", at)) != std::string::npos; at = end + 13)
+		stripped += approximate.substr( at, end - at) + "}\n";
+	CHECK( !stripped.empty() && std::count( stripped.begin(), stripped.end(), '\n') == std::count( approximate.begin(), approximate.end(), '\n'));
+	CHECK( stripped == batch( file, std::nullopt));
+}
+
+}
+
+int main()
+{
+	fewestEdits();
+	exactWithoutEdits();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include "../detail/batch-solver.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+/*
+ * A puzzle of `size` by `size` A's whose key, AA, is found from almost every
+ * cell in every direction.
+ */
+std::string filled( size_t size)
+{
+	std::string text = "Puzzle:\n";
+	for( size_t i = 0; i < size; ++i)
+		text += std::string( size, 'A') + '\n';
+	return text + "Key:\nAA\n";
+}
+
+std::string streamAll( const std::string& file, size_t n_threads, size_t *peak_held = nullptr)
+{
+	std::istringstream in( file);
+	PuzzleFileReader reader( in);
+	detail::PuzzleFeed feed( reader);
+	std::ostringstream out;
+	detail::BatchSolver solver( out, detail::BatchSolver::Format::Csv, PuzzleSolver::Engine::Tracker, n_threads);
+	solver.allOccurrences( true);
+	solver.solve( feed);
+	if( peak_held)
+		*peak_held = solver.peakHeldBytes();
+	return out.str();
+}
+
+/*
+ * With every occurrence streamed out, puzzles waiting behind a large first
+ * one hold back a chunk of records each rather than all of them, and the
+ * output is still in file order.
+ */
+void boundedWhileWaiting()
+{
+	constexpr size_t MiB = 1 << 20;
+	auto file = filled( 200);
+	for( int i = 0; i < 15; ++i)
+		file += filled( 80);
+	file += "end:\n";
+
+	size_t peak_held = 0;
+	auto output = streamAll( file, 4, &peak_held);
+	CHECK( output.size() > 16 * MiB);
+	CHECK( peak_held < 2 * MiB);
+	CHECK( output == streamAll( file, 1));
+	std::string first = "puzzle,word,row,col,direction,reversed\n1,";
+	CHECK( output.compare( 0, first.size(), first) == 0);
+	CHECK( output.compare( output.rfind( '\n', output.size() - 2) + 1, 3, "16,") == 0);
+}
+
+}
+
+int main()
+{
+	boundedWhileWaiting();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,376 @@
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "../detail/batch-solver.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+constexpr PuzzleSolver::Engine ENGINES[] = {
+	PuzzleSolver::Engine::Tracker, PuzzleSolver::Engine::AhoCorasick, PuzzleSolver::Engine::Scan,
+	PuzzleSolver::Engine::Bitboard, PuzzleSolver::Engine::Packed
+};
+
+struct Puzzle
+{
+	std::vector<std::string> rows, keys;
+};
+
+/*
+ * A grid over a few letters, so keys occur many times and in every
+ * direction, and keys of one to six letters: most read off the grid, the
+ * others made up, with repeats, palindromes and single letters among them.
+ */
+Puzzle fuzzed( std::mt19937& random, size_t rows, size_t cols)
+{
+	const std::string letters = "ABCD";
+	auto pick = [ &]( size_t n) { return std::uniform_int_distribution<size_t>( 0, n - 1)( random); };
+	Puzzle puzzle;
+	for( size_t i = 0; i < rows; ++i)
+	{
+		puzzle.rows.emplace_back();
+		for( size_t j = 0; j < cols; ++j)
+			puzzle.rows.back() += letters[ pick( letters.size())];
+	}
+	for( size_t k = 0, n = 4 + pick( 12); k < n; ++k)
+	{
+		auto length = 1 + pick( 6);
+		std::string key;
+		if( pick( 4) != 0)
+		{
+			auto d = 1 + pick( 8);
+			int x = static_cast<int>( pick( rows)), y = static_cast<int>( pick( cols));
+			for( size_t l = 0; l < length && x >= 0 && y >= 0 && x < static_cast<int>( rows) && y < static_cast<int>( cols); ++l)
+			{
+				key += puzzle.rows[ static_cast<size_t>( x)][ static_cast<size_t>( y)];
+				x += detail::DIR_DX[ d], y += detail::DIR_DY[ d];
+			}
+		}
+		else
+			for( size_t l = 0; l < length; ++l)
+				key += letters[ pick( letters.size())];
+		puzzle.keys.push_back( key);
+		if( pick( 8) == 0)
+			puzzle.keys.push_back( key);
+	}
+	return puzzle;
+}
+
+std::string text( const std::vector<Puzzle>& puzzles)
+{
+	std::string file;
+	for( auto& puzzle : puzzles)
+	{
+		file += "Puzzle:\n";
+		for( auto& row : puzzle.rows)
+			file += row + '\n';
+		file += "Key:\n";
+		for( auto& key : puzzle.keys)
+			file += key + '\n';
+	}
+	return file + "end:\n";
+}
+
+std::string batch( const std::string& file, PuzzleSolver::Engine engine, size_t n_threads)
+{
+	std::istringstream in( file);
+	PuzzleFileReader reader( in);
+	detail::PuzzleFeed feed( reader);
+	std::ostringstream out;
+	detail::BatchSolver solver( out, detail::BatchSolver::Format::Json, engine, n_threads);
+	solver.solve( feed);
+	return out.str();
+}
+
+/*
+ * Every occurrence of `key` looked at, and the one Placement::preferredTo
+ * picks: forward before reversed, then the first start in scan order, then
+ * the lowest direction, with keys read against scan order taken as their
+ * reversal along it. Single letters go along S.
+ */
+std::tuple<bool, int, int, int> reference( const Puzzle& puzzle, const std::string& key)
+{
+	auto rows = static_cast<int>( puzzle.rows.size()), cols = static_cast<int>( puzzle.rows[ 0].size());
+	std::tuple<bool, int, int, int> best{ true, rows, cols, 9};
+	for( int x = 0; x < rows; ++x)
+		for( int y = 0; y < cols; ++y)
+			for( int d = 1; d <= 8; ++d)
+			{
+				auto span = static_cast<int>( key.size()) - 1;
+				auto end_x = x + span * detail::DIR_DX[ d], end_y = y + span * detail::DIR_DY[ d];
+				if( end_x < 0 || end_y < 0 || end_x >= rows || end_y >= cols)
+					continue;
+				bool spelled = true;
+				for( int l = 0; spelled && l <= span; ++l)
+					spelled = puzzle.rows[ static_cast<size_t>( x + l * detail::DIR_DX[ d])][ static_cast<size_t>( y + l * detail::DIR_DY[ d])]
+					          == key[ static_cast<size_t>( l)];
+				if( !spelled)
+					continue;
+				auto direction = detail::Dir( d);
+				std::tuple<bool, int, int, int> candidate{ false, x, y, static_cast<int>( direction)};
+				if( span == 0)
+					candidate = { false, x, y, static_cast<int>( detail::Dir::ST)};
+				else if( direction == detail::Dir::NT || direction == detail::Dir::WT
+				         || direction == detail::Dir::NE || direction == detail::Dir::NW)
+					candidate = { true, end_x, end_y, static_cast<int>( detail::opposite( direction))};
+				best = std::min( best, candidate);
+			}
+	return best;
+}
+
+/*
+ * Every engine gives the same output for the same file, serially and with
+ * grids split into tiles.
+ */
+void enginesAgree()
+{
+	std::mt19937 random( 2024);
+	std::vector<Puzzle> puzzles;
+	for( int i = 0; i < 150; ++i)
+		puzzles.push_back( fuzzed( random, 1 + random() % 12, 1 + random() % 12));
+	for( int i = 0; i < 4; ++i)
+		puzzles.push_back( fuzzed( random, 150 + random() % 50, 150 + random() % 50));
+	auto file = text( puzzles);
+
+	auto expected = batch( file, PuzzleSolver::Engine::Tracker, 1);
+	CHECK( !expected.empty());
+	for( auto engine : ENGINES)
+		for( size_t n_threads : { 1, 4})
+			CHECK( batch( file, engine, n_threads) == expected);
+}
+
+/*
+ * `engine` settles on the occurrence the reference picks for every key it
+ * finds, and finds every key that occurs; of repeated keys only one is
+ * reported.
+ */
+void placedAsReference( const Puzzle& puzzle, PuzzleSolver::Engine engine)
+{
+	PuzzleSolver solver( puzzle.rows, puzzle.keys);
+	solver.useEngine( engine);
+	solver.solve();
+	std::vector<bool> found( puzzle.keys.size());
+	for( auto& m : solver.solution())
+	{
+		found[ m.key] = true;
+		auto [ reversed, row, col, direction] = reference( puzzle, puzzle.keys[ m.key]);
+		CHECK( reversed == ( m.reversed != 0) && row == m.row && col == m.col && direction == m.direction);
+	}
+	for( size_t k = 0; k < puzzle.keys.size(); ++k)
+		if( !found[ k])
+		{
+			bool repeated = false;
+			for( size_t other = 0; other < puzzle.keys.size(); ++other)
+				repeated = repeated || ( other != k && found[ other] && puzzle.keys[ other] == puzzle.keys[ k]);
+			CHECK( repeated || std::get<3>( reference( puzzle, puzzle.keys[ k])) == 9);
+		}
+}
+
+/*
+ * The tracker engine settles on the occurrence the reference picks, for
+ * single letters and two letter keys too.
+ */
+void trackerPicksPreferred()
+{
+	std::mt19937 random( 7);
+	for( int i = 0; i < 300; ++i)
+		placedAsReference( fuzzed( random, 1 + random() % 10, 1 + random() % 10), PuzzleSolver::Engine::Tracker);
+}
+
+/*
+ * `text` with a Greek capital for A and a Cyrillic one for C.
+ */
+std::string transliterated( const std::string& text)
+{
+	std::string out;
+	for( auto c : text)
+		out += c == 'A' ? std::string( "Α") : c == 'C' ? std::string( "Ж") : std::string( 1, c);
+	return out;
+}
+
+/*
+ * Lines of `text` in any order, as letters past ASCII sort differently.
+ */
+std::multiset<std::string> lines( const std::string& text)
+{
+	std::multiset<std::string> all;
+	std::istringstream in( text);
+	for( std::string line; std::getline( in, line);)
+		all.insert( line);
+	return all;
+}
+
+/*
+ * Rows as wide as the scan engines' vectors, and a cell either side of
+ * them, with letters past ASCII, whose ids are negative as chars, among
+ * the letters the prefilter compares.
+ */
+void vectorBoundaries()
+{
+	std::mt19937 random( 3);
+	for( size_t cols : { 1, 15, 16, 17, 31, 32, 33, 63, 64, 65})
+	{
+		std::vector<Puzzle> puzzles;
+		for( size_t rows : { 1, 2, 7, 33})
+		{
+			puzzles.push_back( fuzzed( random, rows, cols));
+			for( auto engine : ENGINES)
+				placedAsReference( puzzles.back(), engine);
+		}
+		auto file = text( puzzles);
+		auto expected = lines( transliterated( batch( file, PuzzleSolver::Engine::Tracker, 1)));
+		for( auto engine : ENGINES)
+			CHECK( lines( batch( transliterated( file), engine, 1)) == expected);
+	}
+}
+
+/*
+ * Grids wider than a bitboard word, with keys read off the cells around
+ * every word boundary, in every direction, so shifted boards carry bits
+ * from one word into the next.
+ */
+void wordBoundaries()
+{
+	std::mt19937 random( 11);
+	for( size_t cols : { 63, 64, 65, 127, 128, 129, 200})
+		for( size_t rows : { 1, 3, 70})
+		{
+			auto puzzle = fuzzed( random, rows, cols);
+			for( size_t boundary = 64; boundary < cols + 8; boundary += 64)
+				for( int d = 1; d <= 8; ++d)
+				{
+					auto x = static_cast<int>( random() % rows), y = static_cast<int>( boundary) - 4 + static_cast<int>( random() % 8);
+					std::string key;
+					for( ; x >= 0 && y >= 0 && x < static_cast<int>( rows) && y < static_cast<int>( cols) && key.size() < 10;
+					     x += detail::DIR_DX[ d], y += detail::DIR_DY[ d])
+						key += puzzle.rows[ static_cast<size_t>( x)][ static_cast<size_t>( y)];
+					if( !key.empty())
+						puzzle.keys.push_back( key);
+				}
+			for( auto engine : ENGINES)
+				placedAsReference( puzzle, engine);
+		}
+}
+
+/*
+ * Keys longer than a packed word, and near misses of them that only differ
+ * in their last letter, on grids of two letters where candidates match for
+ * long stretches, including single rows and columns; then the same with
+ * letters past ASCII, which are verified byte by byte.
+ */
+void longKeys()
+{
+	std::mt19937 random( 24);
+	std::vector<Puzzle> puzzles;
+	for( auto [ rows, cols] : { std::pair<size_t, size_t>{ 1, 80}, { 80, 1}, { 2, 50}, { 40, 40}, { 30, 70}})
+	{
+		Puzzle puzzle;
+		for( size_t i = 0; i < rows; ++i)
+		{
+			puzzle.rows.emplace_back();
+			for( size_t j = 0; j < cols; ++j)
+				puzzle.rows.back() += random() % 8 == 0 ? 'A' : 'C';
+		}
+		for( int k = 0; k < 24; ++k)
+		{
+			auto d = 1 + static_cast<int>( random() % 8);
+			auto x = static_cast<int>( random() % rows), y = static_cast<int>( random() % cols);
+			auto length = 11 + random() % 27;
+			std::string key;
+			for( ; x >= 0 && y >= 0 && x < static_cast<int>( rows) && y < static_cast<int>( cols) && key.size() < length;
+			     x += detail::DIR_DX[ d], y += detail::DIR_DY[ d])
+				key += puzzle.rows[ static_cast<size_t>( x)][ static_cast<size_t>( y)];
+			puzzle.keys.push_back( key);
+			key.back() = key.back() == 'A' ? 'C' : 'A';
+			puzzle.keys.push_back( key);
+		}
+		for( auto engine : ENGINES)
+			placedAsReference( puzzle, engine);
+		puzzles.push_back( puzzle);
+	}
+
+	auto file = text( puzzles);
+	auto expected = lines( transliterated( batch( file, PuzzleSolver::Engine::Tracker, 1)));
+	for( auto engine : ENGINES)
+		CHECK( lines( batch( transliterated( file), engine, 1)) == expected);
+}
+
+/*
+ * Every occurrence is reported once, from its first letter along the way it
+ * reads, as enumerating all cells and directions finds them; single letters
+ * once, along S, as the engines place them. Repeated keys are one key here.
+ */
+void everyOccurrence()
+{
+	std::mt19937 random( 15);
+	for( int i = 0; i < 300; ++i)
+	{
+		auto puzzle = fuzzed( random, 1 + random() % 10, 1 + random() % 10);
+		auto rows = static_cast<int>( puzzle.rows.size()), cols = static_cast<int>( puzzle.rows[ 0].size());
+		std::multiset<std::tuple<std::string, int, int, int>> expected, found;
+		for( auto& key : std::set<std::string>( puzzle.keys.begin(), puzzle.keys.end()))
+			for( int x = 0; x < rows; ++x)
+				for( int y = 0; y < cols; ++y)
+					for( int d = 1; d <= 8; ++d)
+					{
+						auto span = static_cast<int>( key.size()) - 1;
+						auto end_x = x + span * detail::DIR_DX[ d], end_y = y + span * detail::DIR_DY[ d];
+						if( end_x < 0 || end_y < 0 || end_x >= rows || end_y >= cols || ( span == 0 && detail::Dir( d) != detail::Dir::ST))
+							continue;
+						bool spelled = true;
+						for( int l = 0; spelled && l <= span; ++l)
+							spelled = puzzle.rows[ static_cast<size_t>( x + l * detail::DIR_DX[ d])][ static_cast<size_t>( y + l * detail::DIR_DY[ d])]
+							          == key[ static_cast<size_t>( l)];
+						if( spelled)
+							expected.emplace( key, x, y, d);
+					}
+
+		PuzzleSolver solver( puzzle.rows, puzzle.keys);
+		solver.forEachOccurrence( [ &]( const PuzzleSolver::Occurrence& o)
+		{
+			found.emplace( puzzle.keys[ o.key], o.row, o.col, static_cast<int>( o.direction));
+		});
+		CHECK( found == expected);
+	}
+}
+
+/*
+ * The grid of the report that found the tracker engine missing short keys.
+ */
+void shortKeys()
+{
+	auto expected = "{\"puzzle\":1,\"word\":\"AB\",\"row\":0,\"col\":1,\"direction\":\"E\",\"reversed\":false}\n"
+	                "{\"puzzle\":1,\"word\":\"CAT\",\"row\":2,\"col\":0,\"direction\":\"E\",\"reversed\":false}\n"
+	                "{\"puzzle\":1,\"word\":\"X\",\"row\":0,\"col\":0,\"direction\":\"S\",\"reversed\":false}\n";
+	for( auto engine : ENGINES)
+		CHECK( batch( "Puzzle:\nXABX\nXXXX\nCATX\nKey:\nAB\nZ\nCAT\nX\nend:\n", engine, 1) == expected);
+}
+
+}
+
+int main()
+{
+	shortKeys();
+	trackerPicksPreferred();
+	vectorBoundaries();
+	wordBoundaries();
+	longKeys();
+	everyOccurrence();
+	enginesAgree();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../detail/batch-solver.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+constexpr PuzzleSolver::Engine ENGINES[] = {
+	PuzzleSolver::Engine::Tracker, PuzzleSolver::Engine::AhoCorasick, PuzzleSolver::Engine::Scan,
+	PuzzleSolver::Engine::Bitboard, PuzzleSolver::Engine::Packed
+};
+
+const std::string TEXT = "Puzzle:\nCATXX\nXDOGX\nXXXXX\nKey:\nCAT\nGOD\nX\nBIRD\n"
+                         "Puzzle:\nγάτα\nαxxx\nKey:\nΓΆΤΑ\nΑΓ\n"
+                         "Puzzle:\nab\ncd\nKey:\nDB\nAD\nend:\n";
+
+std::vector<PuzzleImage> parsed( PuzzleFileReader& reader)
+{
+	std::vector<PuzzleImage> images;
+	while( auto image = reader.next())
+		images.push_back( std::move( *image));
+	return images;
+}
+
+std::string batch( detail::PuzzleFeed& feed, PuzzleSolver::Engine engine)
+{
+	std::ostringstream out;
+	detail::BatchSolver solver( out, detail::BatchSolver::Format::Csv, engine, 2);
+	solver.solve( feed);
+	return out.str();
+}
+
+std::string batch( const std::string& text, PuzzleSolver::Engine engine)
+{
+	std::istringstream in( text);
+	PuzzleFileReader reader( in);
+	detail::PuzzleFeed feed( reader);
+	return batch( feed, engine);
+}
+
+std::string compiled( const std::string& path, PuzzleSolver::Engine engine, bool precompute)
+{
+	std::istringstream in( TEXT);
+	PuzzleFileReader reader( in);
+	std::function<std::vector<detail::SolutionCache::Match>( const PuzzleImage&)> solve;
+	if( precompute)
+		solve = [ engine]( const PuzzleImage& image)
+		{
+			PuzzleSolver solver( image.puzzle, image.keys);
+			solver.useEngine( engine);
+			solver.solve();
+			return solver.solution();
+		};
+	CHECK( detail::PuzzleArchive::compile( reader, path, static_cast<int>( engine), solve));
+	return path;
+}
+
+/*
+ * An archive holds the puzzles of the text as they were read, letters past
+ * ASCII included, and the matches when compiled with --precompute; solving
+ * from it gives what solving the text does.
+ */
+void roundTrip( const std::string& directory)
+{
+	std::istringstream in( TEXT);
+	PuzzleFileReader reader( in);
+	auto expected = parsed( reader);
+	CHECK( expected.size() == 3);
+
+	for( auto precompute : { false, true})
+		for( auto engine : ENGINES)
+		{
+			auto archive = detail::PuzzleArchive::open(
+				detail::MappedFile::open( compiled( directory + "/puzzles.pzb", engine, precompute).c_str()));
+			CHECK( archive != nullptr && archive->size() == expected.size());
+			for( size_t i = 0; i < expected.size(); ++i)
+			{
+				auto image = archive->get( i);
+				CHECK( image.has_value());
+				CHECK( image->puzzle.rows() == expected[ i].puzzle.rows() && image->puzzle.cols() == expected[ i].puzzle.cols());
+				for( size_t row = 0; row < image->puzzle.rows(); ++row)
+					CHECK( image->puzzle.spell( image->puzzle.row( row)) == expected[ i].puzzle.spell( expected[ i].puzzle.row( row)));
+				CHECK( image->keys.size() == expected[ i].keys.size());
+				for( size_t k = 0; k < image->keys.size(); ++k)
+					CHECK( image->puzzle.spell( image->keys[ k]) == expected[ i].puzzle.spell( expected[ i].keys[ k]));
+				CHECK( ( image->solution.matches != nullptr) == precompute);
+				CHECK( image->solution.engine == static_cast<int>( precompute ? engine : PuzzleSolver::Engine( -1)));
+			}
+			CHECK( !archive->get( expected.size()));
+
+			detail::PuzzleFeed feed( archive);
+			CHECK( batch( feed, engine) == batch( TEXT, engine));
+		}
+}
+
+/*
+ * Stored matches are taken as they are, without solving again.
+ */
+void storedMatchesAreUsed( const std::string& directory)
+{
+	auto path = directory + "/planted.pzb";
+	std::istringstream in( TEXT);
+	PuzzleFileReader reader( in);
+	CHECK( detail::PuzzleArchive::compile( reader, path, static_cast<int>( PuzzleSolver::Engine::Scan), []( const PuzzleImage&)
+	{
+		return std::vector<detail::SolutionCache::Match>{ { 0, 1, 0, static_cast<uint8_t>( detail::Dir::NE), 0}};
+	}));
+	detail::PuzzleFeed feed( detail::PuzzleArchive::open( detail::MappedFile::open( path.c_str())));
+	CHECK( batch( feed, PuzzleSolver::Engine::Tracker) == "puzzle,word,row,col,direction,reversed\n"
+	                                                      "1,CAT,1,0,NE,false\n"
+	                                                      "2,ΓΆΤΑ,1,0,NE,false\n"
+	                                                      "3,DB,1,0,NE,false\n");
+}
+
+/*
+ * Text is not taken for an archive.
+ */
+void textIsNotAnArchive( const std::string& directory)
+{
+	auto path = directory + "/puzzles.txt";
+	std::ofstream( path) << TEXT;
+	CHECK( detail::PuzzleArchive::open( detail::MappedFile::open( path.c_str())) == nullptr);
+}
+
+}
+
+int main()
+{
+	char root[] = "/tmp/puzzler-archive-XXXXXX";
+	CHECK( mkdtemp( root) != nullptr);
+	roundTrip( root);
+	storedMatchesAreUsed( root);
+	textIsNotAnArchive( root);
+	std::filesystem::remove_all( root);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "../detail/batch-solver.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+constexpr size_t PUZZLES = 1000;
+
+std::string many()
+{
+	std::string file;
+	for( size_t i = 0; i < PUZZLES; ++i)
+		file += "Puzzle:\nCATX\nXDOG\nKey:\nCAT\nDOG\n";
+	return file + "end:\n";
+}
+
+/*
+ * Number of puzzles parsed once the parser has had time to reach `expected`
+ * and a while longer to overshoot it.
+ */
+size_t settled( detail::PuzzleFeed& feed, size_t expected)
+{
+	for( int i = 0; i < 500 && feed.available() < expected; ++i)
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10));
+	std::this_thread::sleep_for( std::chrono::milliseconds( 50));
+	return feed.available();
+}
+
+/*
+ * The parser keeps a bounded distance ahead of the puzzles asked for, and
+ * puzzles let go of are no longer handed out while later ones still are.
+ */
+void boundedLookahead()
+{
+	std::istringstream in( many());
+	PuzzleFileReader reader( in);
+	detail::PuzzleFeed feed( reader);
+	CHECK( feed.get( 0) != nullptr);
+	CHECK( settled( feed, 1 + detail::PuzzleFeed::LOOKAHEAD) == 1 + detail::PuzzleFeed::LOOKAHEAD);
+
+	auto kept = feed.get( 300);
+	CHECK( kept != nullptr && kept->keys.size() == 2);
+	CHECK( settled( feed, 301 + detail::PuzzleFeed::LOOKAHEAD) == 301 + detail::PuzzleFeed::LOOKAHEAD);
+	feed.release( 300);
+	CHECK( feed.get( 299) == nullptr && feed.get( 0) == nullptr);
+	CHECK( feed.get( 300) == kept && feed.get( 301) != nullptr);
+
+	CHECK( feed.size() == PUZZLES);
+	CHECK( feed.get( PUZZLES - 1) != nullptr && feed.get( PUZZLES) == nullptr);
+}
+
+/*
+ * The simulator goes back and forth, and nothing it has seen goes away.
+ */
+void randomAccess()
+{
+	std::istringstream in( many());
+	PuzzleFileReader reader( in);
+	detail::PuzzleFeed feed( reader);
+	auto first = feed.get( 0);
+	CHECK( feed.get( PUZZLES - 1) != nullptr);
+	CHECK( feed.get( 0) == first && feed.get( 500) != nullptr);
+}
+
+/*
+ * A batch run lets go of the puzzles it has written out.
+ */
+void batchReleases()
+{
+	std::istringstream in( many());
+	PuzzleFileReader reader( in);
+	detail::PuzzleFeed feed( reader);
+	std::ostringstream out;
+	detail::BatchSolver solver( out, detail::BatchSolver::Format::Csv, PuzzleSolver::Engine::Scan, 2);
+	solver.solve( feed);
+	CHECK( feed.get( 0) == nullptr);
+	CHECK( feed.get( PUZZLES - 1) != nullptr);
+	auto text = out.str();
+	std::string last = "1000,DOG,1,1,E,false\n";
+	CHECK( text.size() > last.size() && text.compare( text.size() - last.size(), last.size(), last) == 0);
+}
+
+}
+
+int main()
+{
+	boundedLookahead();
+	randomAccess();
+	batchReleases();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include "../detail/puzzle-generator.hpp"
+#include "../detail/puzzle-solver.hpp"
+#include "../detail/sha256.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+detail::GeneratorSpec spec( uint64_t seed)
+{
+	detail::GeneratorSpec spec;
+	spec.seed       = seed;
+	spec.puzzles    = 3;
+	spec.rows       = 12;
+	spec.cols       = 15;
+	spec.keys       = 10;
+	spec.decoys     = 0.5;
+	spec.directions = *detail::PuzzleGenerator::parseDirections( "all");
+	return spec;
+}
+
+std::string written( const detail::GeneratorSpec& spec)
+{
+	std::ostringstream out;
+	detail::PuzzleGenerator( spec).write( out);
+	return out.str();
+}
+
+/*
+ * A seed names one file, the same on every platform and standard library;
+ * the digest pins it down.
+ */
+void samePerSeed()
+{
+	auto text = written( spec( 2024));
+	CHECK( text == written( spec( 2024)));
+	CHECK( text != written( spec( 2025)));
+	CHECK( text.compare( 0, 24, "Puzzle:\nNASNAVNIXDOOAVA\n") == 0);
+	detail::Sha256 hash;
+	hash.update( text);
+	CHECK( detail::Sha256::hex( hash.digest()) == "d4a1963be7773d92d96ddcfde60f87171c5ddc2508ca48d4ba7102f582254aee");
+}
+
+/*
+ * Puzzles have the size asked for and every key listed can be found, along
+ * one of the directions allowed, as written or back to front.
+ */
+void keysArePlaced()
+{
+	for( uint64_t seed = 1; seed <= 20; ++seed)
+	{
+		auto s = spec( seed);
+		s.directions = { detail::Dir::ET, detail::Dir::SE};
+		s.min_length = 4;
+		s.max_length = 7;
+		detail::PuzzleGenerator generator( s);
+		for( size_t n = 0; n < s.puzzles; ++n)
+		{
+			auto puzzle = generator.next();
+			CHECK( puzzle.rows.size() == s.rows);
+			for( auto& row : puzzle.rows)
+				CHECK( row.size() == s.cols);
+			CHECK( !puzzle.keys.empty() && puzzle.keys.size() <= s.keys);
+
+			PuzzleSolver solver( puzzle.rows, puzzle.keys);
+			solver.solve();
+			CHECK( solver.solution().size() == puzzle.keys.size());
+			for( auto& m : solver.solution())
+			{
+				auto length = puzzle.keys[ m.key].size();
+				CHECK( length >= s.min_length && length <= s.max_length);
+				// Keys written back to front are read along the same line, reversed.
+				auto direction = detail::Dir( m.direction);
+				CHECK( direction == detail::Dir::ET || direction == detail::Dir::SE);
+			}
+		}
+	}
+}
+
+void directionNames()
+{
+	auto some = detail::PuzzleGenerator::parseDirections( "N,SE");
+	CHECK( some && *some == ( std::vector<detail::Dir>{ detail::Dir::NT, detail::Dir::SE}));
+	CHECK( detail::PuzzleGenerator::parseDirections( "all")->size() == 8);
+	CHECK( !detail::PuzzleGenerator::parseDirections( "N,UP"));
+	CHECK( !detail::PuzzleGenerator::parseDirections( ""));
+}
+
+}
+
+int main()
+{
+	samePerSeed();
+	keysArePlaced();
+	directionNames();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "../detail/puzzle-solver.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+using Match = detail::SolutionCache::Match;
+
+bool same( const std::vector<Match>& left, const std::vector<Match>& right)
+{
+	auto equal = []( const Match& l, const Match& r)
+	{
+		return l.key == r.key && l.row == r.row && l.col == r.col && l.direction == r.direction && l.reversed == r.reversed;
+	};
+	return std::equal( left.begin(), left.end(), right.begin(), right.end(), equal);
+}
+
+/*
+ * Names of the entries in `directory`, whatever shard they are in.
+ */
+std::vector<std::string> entries( const std::string& directory)
+{
+	std::vector<std::string> names;
+	for( auto& shard : std::filesystem::directory_iterator( directory))
+		if( shard.is_directory())
+			for( auto& file : std::filesystem::directory_iterator( shard.path()))
+				names.push_back( file.path().filename().string());
+	return names;
+}
+
+detail::Sha256::Digest digestOf( const std::string& text)
+{
+	detail::Sha256 hash;
+	hash.update( text);
+	return hash.digest();
+}
+
+/*
+ * Entries come back as they were stored; missing and damaged ones do not
+ * come back at all.
+ */
+void roundTrip( const std::string& directory)
+{
+	detail::SolutionCache cache( directory + "/", 1 << 20);
+	std::vector<Match> matches{ { 0, 1, 2, 3, 0}, { 2, -1, 70000, 8, 1}};
+	cache.store( digestOf( "one"), matches);
+	cache.store( digestOf( "none"), {});
+
+	auto found = cache.lookup( digestOf( "one"));
+	CHECK( found && same( *found, matches));
+	auto empty = cache.lookup( digestOf( "none"));
+	CHECK( empty && empty->empty());
+	CHECK( !cache.lookup( digestOf( "two")));
+
+	auto name = detail::Sha256::hex( digestOf( "one"));
+	std::filesystem::resize_file( directory + "/" + name.substr( 0, 2) + "/" + name, 20);
+	CHECK( !cache.lookup( digestOf( "one")));
+}
+
+/*
+ * A solve stores its matches, and the next solve of the same puzzle, with
+ * any engine, takes whatever the entry holds instead of solving.
+ */
+void solverUsesEntries( const std::string& directory)
+{
+	detail::SolutionCache cache( directory, 1 << 20);
+	std::vector<std::string> rows{ "CATX", "XDOG", "XXXX"}, keys{ "CAT", "DOG", "GOD"};
+	PuzzleSolver first( rows, keys);
+	first.useCache( &cache);
+	first.solve();
+	auto names = entries( directory);
+	CHECK( names.size() == 1);
+	CHECK( first.solution().size() == 3);
+
+	// Plant a made up solution under the puzzle's entry.
+	detail::Sha256::Digest key{};
+	for( size_t i = 0; i < key.size(); ++i)
+		key[ i] = static_cast<uint8_t>( std::stoi( names[ 0].substr( 2 * i, 2), nullptr, 16));
+	std::vector<Match> planted{ { 1, 2, 3, static_cast<uint8_t>( detail::Dir::WT), 0}};
+	cache.store( key, planted);
+
+	PuzzleSolver second( rows, keys);
+	second.useEngine( PuzzleSolver::Engine::Packed);
+	second.useCache( &cache);
+	second.solve();
+	CHECK( same( second.solution(), planted));
+	CHECK( entries( directory).size() == 1);
+
+	PuzzleSolver other( rows, std::vector<std::string>{ "CAT"});
+	other.useCache( &cache);
+	other.solve();
+	CHECK( entries( directory).size() == 2);
+}
+
+/*
+ * Past its limit the cache drops the least recently used entries, down to
+ * three quarters of the limit. Entries are counted as the block each takes
+ * up on disk.
+ */
+void trimsLeastRecentlyUsed( const std::string& directory)
+{
+	constexpr uint64_t BLOCK = 4096, LIMIT = 16 * BLOCK;
+	detail::SolutionCache cache( directory, LIMIT);
+	for( int i = 0; i < 64; ++i)
+	{
+		cache.store( digestOf( std::to_string( i)), { { static_cast<uint32_t>( i), 0, 0, 2, 0}});
+		// The first entry is looked up all along, so it stays.
+		CHECK( cache.lookup( digestOf( "0")));
+	}
+	auto kept = entries( directory).size();
+	// Trims come every eighth of the limit written, so it is overshot by that much at most.
+	CHECK( kept > 0 && kept * BLOCK <= LIMIT + LIMIT / 8);
+	CHECK( cache.lookup( digestOf( "0")) && cache.lookup( digestOf( "63")));
+	CHECK( !cache.lookup( digestOf( "1")));
+}
+
+}
+
+int main()
+{
+	char root[] = "/tmp/puzzler-cache-XXXXXX";
+	CHECK( mkdtemp( root) != nullptr);
+	roundTrip( std::string( root) + "/round-trip");
+	solverUsesEntries( std::string( root) + "/solver");
+	trimsLeastRecentlyUsed( std::string( root) + "/trim");
+	std::filesystem::remove_all( root);
+	return EXIT_SUCCESS;
+}
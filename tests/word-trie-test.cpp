@@ -0,0 +1,114 @@
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include "../detail/puzzle-reader.hpp"
+#include "../detail/word-trie.hpp"
+
+#define CHECK( condition)                                                              \
+	do                                                                                 \
+	{                                                                                  \
+		if( !( condition))                                                             \
+		{                                                                              \
+			fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit( EXIT_FAILURE);                                                       \
+		}                                                                              \
+	} while( false)
+
+namespace
+{
+
+size_t countTries( const std::string& directory)
+{
+	size_t count = 0;
+	if( auto dir = opendir( directory.c_str()))
+	{
+		while( auto entry = readdir( dir))
+			count += std::string_view( entry->d_name).size() > 5
+			         && std::string_view( entry->d_name).substr( std::string_view( entry->d_name).size() - 5) == ".trie";
+		closedir( dir);
+	}
+	return count;
+}
+
+/*
+ * A word list whose directory cannot be written to is compiled into the
+ * cache directory, and that copy is reused by the next lookup.
+ */
+void readOnlyListDirectory()
+{
+	char root[] = "/tmp/puzzler-trie-XXXXXX";
+	CHECK( mkdtemp( root) != nullptr);
+	std::string cache = std::string( root) + "/cache", dict = std::string( root) + "/dict",
+	            list = dict + "/words";
+	setenv( "XDG_CACHE_HOME", cache.c_str(), 1);
+	CHECK( mkdir( dict.c_str(), 0755) == 0);
+	std::ofstream( list) << "cat\nDog\nbird\ncat\nnot-a-word\n";
+	// Root ignores the mode, so the name the compiled copy is written under is taken too.
+	CHECK( mkdir( ( list + ".trie.partial").c_str(), 0755) == 0);
+	CHECK( chmod( dict.c_str(), 0555) == 0);
+
+	auto trie = detail::WordTrie::fromFile( list);
+	CHECK( trie != nullptr);
+	CHECK( trie->size() == 3);
+	CHECK( trie->word( 0) == "BIRD" && trie->word( 1) == "CAT" && trie->word( 2) == "DOG");
+	CHECK( access( ( list + ".trie").c_str(), F_OK) != 0);
+	CHECK( countTries( cache + "/puzzler/tries") == 1);
+
+	auto again = detail::WordTrie::fromFile( list);
+	CHECK( again != nullptr && again->size() == 3);
+	CHECK( countTries( cache + "/puzzler/tries") == 1);
+
+	chmod( dict.c_str(), 0755);
+	std::filesystem::remove_all( root);
+}
+
+/*
+ * Words past ASCII are upper-cased like keys and found in grids spelled in
+ * any case; a compiled copy in an older format is rebuilt.
+ */
+void lettersPastAscii()
+{
+	char root[] = "/tmp/puzzler-trie-XXXXXX";
+	CHECK( mkdtemp( root) != nullptr);
+	std::string list = std::string( root) + "/words";
+	std::ofstream( list) << "γάτα\nΣκύλος\nκότα\nsun\nΓάτα\nnot a word\nκ-α\n";
+	std::ofstream( list + ".trie") << std::string( "PZTRIE1\0", 8) << std::string( 28, '\0');
+
+	auto trie = detail::WordTrie::fromFile( list);
+	CHECK( trie != nullptr);
+	CHECK( trie->size() == 4);
+	CHECK( trie->word( 0) == "SUN" && trie->word( 1) == "ΓΆΤΑ" && trie->word( 2) == "ΚΌΤΑ" && trie->word( 3) == "ΣΚΎΛΟΣ");
+
+	std::istringstream in( "Puzzle:\nxγάταx\nxxxxxκ\nxxxxxό\nxxxxxτ\nSUNxxα\nKey:\nx\nend:\n");
+	PuzzleFileReader reader( in);
+	auto image = reader.next();
+	CHECK( image.has_value());
+	std::set<std::tuple<std::string, int, int, detail::Dir>> found;
+	trie->search( image->puzzle, [ &]( uint32_t word, int row, int col, detail::Dir direction)
+	{
+		found.emplace( trie->word( word), row, col, direction);
+	});
+	std::set<std::tuple<std::string, int, int, detail::Dir>> expected{
+		{ "ΓΆΤΑ", 0, 1, detail::Dir::ET}, { "ΚΌΤΑ", 1, 5, detail::Dir::ST}, { "SUN", 4, 0, detail::Dir::ET}
+	};
+	CHECK( found == expected);
+
+	std::filesystem::remove_all( root);
+}
+
+}
+
+int main()
+{
+	readOnlyListDirectory();
+	lettersPastAscii();
+	return EXIT_SUCCESS;
+}